@@ -1,15 +1,15 @@
-from time import time
 from subprocess import call
 
-for pt in range(0, 5):
-  nbThreads = 2 ** pt
-  for pp in range (0, 10):
-    nbParts = 2 ** pp
-    for r in range(-10, 11, 2):
-      for i in range(-10, 11, 2):
-        start = time()
-        for j in range(0, 1):
-          call(["./julia_bw", str(nbThreads), str(nbParts), str(r / 10), str(i / 10)])
-        end = time()
-        diff = end - start
-        print('%d,%d,%f,%f,%f' % (nbThreads, nbParts, r / 10, i / 10, diff))
+# Tout le balayage tourne dans un seul processus (julia_bw2 --bench) : le pool
+# de threads et les tampons ne sont créés qu'une fois et chaque point est
+# mesuré plusieurs fois (médiane et p95).
+# Colonnes : threads,tuile,reel,imag,mediane,p95,maxIter,precision,simd,Mpixel/s,Giter/s
+# (les cinq premières ont le même sens que dans results6, la taille de tuile
+# remplaçant le nombre de parts).
+call(["./julia_bw2", "--bench",
+      "threads=1,2,4,8,16",
+      "tiles=8,16,32,64,128,256",
+      "c=-1:1:0.2",
+      "maxiter=300",
+      "warmup=1",
+      "reps=5"])
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <opencv2/opencv.hpp>
 #include <pthread.h>
+#include "kernels.h" // Noyaux vectorisés (AVX2 / AVX-512)
 
 /* CONSTANTES *****************************************************************/
 
@@ -95,13 +96,22 @@ void* child(void *arg) {
         int part = nextPart++;
         pthread_mutex_unlock(&mutex);
 
-        for (int i = part * partSize; i < IMG_H * IMG_W && i < (part + 1) * partSize; i++) {
-            int x = i % IMG_W;
+        int end = std::min((part + 1) * partSize, IMG_H * IMG_W);
+        for (int i = part * partSize; i < end; ) {
+            int x0 = i % IMG_W;
             int y = i / IMG_W;
-
-            int j = juliaDot(convert(x, y), MAX_ITER);
-            cv::Vec3b color(j, j, j);
-            newImg.at<cv::Vec3b>(cv::Point(x, y)) = color;
+            int n = std::min(IMG_W - x0, end - i);
+            int its[IMG_W];
+
+            complex z = convert(x0, y);
+            escapeSpanDouble(z.real, z.imag, (long double) (LIMIT_RIGHT - LIMIT_LEFT) / IMG_W, 0.0, n,
+                             c.real, c.imag, MAX_ITER, its, true, NULL);
+            for (int x = x0; x < x0 + n; x++) {
+                int j = its[x - x0] * 255 / MAX_ITER;
+                cv::Vec3b color(j, j, j);
+                newImg.at<cv::Vec3b>(cv::Point(x, y)) = color;
+            }
+            i += n;
         }
 
         pthread_mutex_lock(&mutex);
@@ -1,8 +1,28 @@
 #include <stdio.h>
 #include <opencv2/opencv.hpp>
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <png.h>
+#include <stdint.h>
+#include <signal.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <deque>
 #include "palettes.h" // Contient les palettes (attention, c'est brut...)
+#include "kernels.h" // Noyaux vectorisés (AVX2 / AVX-512)
 
 /* CONSTANTES *****************************************************************/
 
@@ -10,6 +30,13 @@
 #define IMG_H 1024 //768
 #define MAX_NORM 4        // 2
 #define STEP 0.05
+#define TILE_SIZE 32 // côté des tuiles distribuées aux threads
+#define PASSES 4     // rendu progressif : 1/8, 1/4, 1/2 puis pleine résolution
+#define AA_PASS PASSES // passe supplémentaire d'anticrénelage
+// Taille minimale d'un pixel pour chaque précision (en dessous, elle ne suffit plus)
+#define FLOAT_MIN_STEP 1e-3
+#define DOUBLE_MIN_STEP 1e-12
+#define LONG_DOUBLE_MIN_STEP 1e-15
 
 /* GLOBALES *******************************************************************/
 
@@ -21,162 +48,3424 @@ typedef enum {
   COLOR_MODES
 } color_mode_t;
 
+const char* colorNames[] = {"hue", "bw", "palette1", "palette2"};
+
+typedef enum {
+  FRAME_FULL = 0, // passes progressives sur toute l'image
+  FRAME_PAN,      // seulement la bande découverte par un déplacement
+  FRAME_RESUME,   // seulement les orbites arrêtées par l'ancien maxIter
+  FRAME_AA        // seulement l'anticrénelage d'une image terminée
+} frame_mode_t;
+
+typedef enum {
+  PREC_AUTO = 0,
+  PREC_FLOAT,
+  PREC_DOUBLE,
+  PREC_LONG_DOUBLE,
+  PREC_PERTURBATION,
+  PRECISIONS
+} precision_t;
+
+const char* precisionNames[] = {"auto", "float", "double", "long double", "perturbation"};
+
 int nbThreads = 1;
-int nbPartsPerThread = 1;
-int nbParts = 1;
+int activeThreads = 1; // threads du pool qui prennent des tuiles (benchmark)
+int tileSize = TILE_SIZE;
+int tilesX = 0;
+int tilesY = 0;
+int nbTiles = 0;
+int *tileOrder = NULL; // ordre de distribution des tuiles (les plus chères d'abord)
+long *tileCost = NULL; // itérations de chaque tuile lors de son dernier calcul
+
+// Le travail est publié par "époque" : une époque correspond à une passe
+// d'une image. ticket contient (époque << 32) | indice de la prochaine tuile
+// et chaque thread réserve une tuile avec __atomic_fetch_add. Changer
+// d'époque invalide immédiatement toutes les tuiles en cours.
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER; // protège les changements d'époque
+pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER; // signale frameDone
+unsigned workEpoch = 1; // le ticket initial (époque 0) ne donne aucun travail
+unsigned long long ticket = 0;
+int curPass = 0;
+int tilesDone = 0; // tuiles terminées dans la passe en cours
+int inFlight = 0;  // threads en train de traiter une tuile
+bool frameDone = false; // toutes les passes de l'image en cours sont finies
+frame_mode_t frameMode = FRAME_FULL;
+cv::Mat newImg(IMG_H, IMG_W, CV_8UC3, cv::Vec3b(0,0,0));
+int iterBuf[IMG_W * IMG_H]; // nombre d'itérations de chaque pixel
+// Tampons d'affichage (voir PRESENTATION) : l'image affichée est coloriée
+// depuis shownBuf[shownFront], jamais depuis iterBuf
+int shownBuf[3][IMG_W * IMG_H];
+int shownFront = 0;
+int shownReading = -1;   // tampon en cours de coloriage (-1 : aucun)
+bool frontFinal = false; // le tampon avant est la dernière passe de l'image en cours
+pthread_mutex_t displayMutex = PTHREAD_MUTEX_INITIALIZER; // protège les trois variables ci-dessus
+// Orbites des pixels qui n'ont pas divergé, pour reprendre le calcul quand
+// maxIter augmente (précisions float et double seulement) : z après
+// orbitIter[p] itérations, ou l'un des états suivants.
+#define ORBIT_DONE -1     // le point a divergé (ou rien à reprendre)
+#define ORBIT_PERIODIC -2 // orbite périodique, ne divergera jamais
+#define ORBIT_UNKNOWN -3  // pixel relu du cache sans son orbite : à recalculer
+double orbitRe[IMG_W * IMG_H];
+double orbitIm[IMG_W * IMG_H];
+int orbitIter[IMG_W * IMG_H];
+// Anticrénelage des pixels de bord (voir ANTICRENELAGE)
+int aaFrameGrid = 0;     // grille de sous-échantillons de l'image en cours (0 : sans)
+long aaPixels = 0;       // pixels raffinés dans l'image en cours (lu par l'affichage : atomique)
+// 0 : pixel non raffiné, > 0 : 1 + position dans aaTileIts de sa tuile,
+// < 0 : -(1 + q), les sous-échantillons sont ceux de son symétrique q
+int aaIndex[IMG_W * IMG_H];
+std::vector<int> *aaTileIts = NULL; // par tuile, les sous-échantillons de ses pixels raffinés
+bool keepGoing = true;
+int offsetColor = 0;
+color_mode_t colorMode = HUE;
+precision_t forcedPrecision = PREC_AUTO;
+fractal_t fractal = FRACTAL_JULIA;
+
+long double offsetLeft = 0.0;
+long double offsetTop = 0.0;
+long double offsetLeftLo = 0.0; // partie basse des offsets (zoom profond)
+long double offsetTopLo = 0.0;
+long double limitLeft = -1.0;
+long double limitRight = 1.0;
+long double limitTop = -1.0;
+long double limitBottom = 1.0;
+
+int maxIter = 300;
+long double zoom = 1.0;
+
+/* INSTRUMENTATION ***********************************************************/
+
+// Compteurs de chaque thread de calcul. Chaque thread n'écrit que dans sa
+// propre case (alignée sur une ligne de cache), les totaux sont faits à la
+// fin de l'image.
+typedef struct {
+    long tiles;     // tuiles traitées
+    long iters;     // itérations effectuées
+    long saved;     // itérations évitées par la détection de cycles
+    double busy;    // temps passé dans les tuiles (s)
+    double wait;    // temps passé à attendre du travail pendant l'image (s)
+    double lastEnd; // fin de la dernière tuile (s, horloge monotone)
+    long cost;      // coût mesuré de la tuile en cours (-1 : aucun)
+    int records;    // tuiles de ce thread pas encore reportées (tileRecords)
+} __attribute__((aligned(64))) worker_stats_t;
+
+// Une tuile traitée par un thread : reportée dans tileIters et tileCost à
+// la fin de la passe, par un seul thread, plutôt qu'écrite tout de suite
+// dans ces tableaux partagés.
+typedef struct {
+    int tile;
+    long iters;
+    long cost; // -1 : coût inchangé
+} tile_record_t;
+
+worker_stats_t *workerStats = NULL;
+__thread worker_stats_t *myStats = NULL; // case du thread courant
+long *tileIters = NULL; // itérations de chaque tuile pour l'image en cours (toutes passes)
+// recordStride cases par thread, dont RECORD_GAP vides à la fin : deux
+// threads n'écrivent jamais sur la même ligne de cache
+#define RECORD_GAP (64 / sizeof(tile_record_t) + 1)
+tile_record_t *tileRecords = NULL;
+int recordStride = 0;
+double frameStart = 0.0;
+double frameEnd = 0.0;
+long frameIters = 0; // itérations effectuées pour l'image en cours
+long frameSaved = 0; // itérations évitées grâce à la détection de cycles
+int frameCount = 0;  // images terminées
+
+// Compteurs recopiés à la fin de chaque passe pour l'affichage 'i' : le
+// thread principal ne lit jamais ceux que les threads sont en train
+// d'incrémenter.
+typedef struct {
+    frame_mode_t mode;
+    bool done;
+    double start;
+    double end;          // fin de la passe recopiée
+    long iters;
+    long saved;
+    long hits;           // tuiles recopiées du cache pour l'image
+    long misses;
+    long totalHits;      // depuis le lancement
+    long totalMisses;
+    int threads;
+    worker_stats_t *workers;
+    long *tileIters;
+} stats_snapshot_t;
+
+stats_snapshot_t passStats;  // rempli sous mutex par passFinished
+stats_snapshot_t shownStats; // copie dessinée par drawStats
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool initStats() {
+    void *p = NULL;
+    free(workerStats);
+    workerStats = NULL;
+    if (posix_memalign(&p, 64, nbThreads * sizeof(worker_stats_t)) != 0) {
+        return false;
+    }
+    workerStats = (worker_stats_t*) p;
+    memset(workerStats, 0, nbThreads * sizeof(worker_stats_t));
+    free(passStats.workers);
+    free(shownStats.workers);
+    passStats.workers = (worker_stats_t*) calloc(nbThreads, sizeof(worker_stats_t));
+    shownStats.workers = (worker_stats_t*) calloc(nbThreads, sizeof(worker_stats_t));
+    return passStats.workers && shownStats.workers;
+}
+
+/* MANIPULER LES NOMBRES COMPLEXES ********************************************/
+
+typedef struct {
+    long double real;
+    long double imag;
+} complex;
+complex c; // GLOBALE
+ref_orbit_t *refOrbit = NULL;  // orbite du centre de l'image (perturbation)
+ref_orbit_t *critOrbit = NULL; // orbite du point critique 0 (perturbation)
+
+complex new_complex(long double real, long double imag) {
+    complex c;
+    c.real = real;
+    c.imag = imag;
+    return c;
+}
+
+complex add_complex(complex a, complex b) {
+    a.real += b.real;
+    a.imag += b.imag;
+    return a;
+}
+
+complex mult_complex(complex a, complex b) {
+    complex m;
+    m.real = a.real * b.real - a.imag * b.imag;
+    m.imag = a.real * b.imag + a.imag * b.real;
+    return m;
+}
+
+long double module_complex(complex c) {
+    return c.real * c.real + c.imag * c.imag;
+}
+
+/* FRACTALE DE JULIA *****************************************************/
+
+// Point du plan au pixel (x, y), qui peut être fractionnaire (sous-échantillons)
+complex convert(long double x, long double y) {
+   return new_complex(
+        ((long double) x / IMG_W * (limitRight - limitLeft) + limitLeft) * zoom + offsetLeft,
+        ((long double) y / IMG_H * (limitBottom - limitTop) + limitTop) * zoom + offsetTop);
+}
+
+int juliaDot(complex z, int iter) {
+	int i;
+    for (i = 0; i < iter; i++) {
+        z = add_complex(mult_complex(z, z), c);
+        long double norm = module_complex(z);
+        if (norm > MAX_NORM) {
+            break;
+        }
+    }
+    return i * 255 / iter; // on met i dans l'intervalle 0 à 255
+}
+
+long double pixelStep() {
+    return (limitRight - limitLeft) / IMG_W * zoom;
+}
+
+// Précision à utiliser pour des pixels de taille step. La perturbation
+// n'existe que pour z² + c : les autres formules s'arrêtent au long double.
+precision_t precisionFor(long double step) {
+    if (forcedPrecision == PREC_PERTURBATION && fractal != FRACTAL_JULIA) {
+        return PREC_LONG_DOUBLE;
+    }
+    if (forcedPrecision != PREC_AUTO) {
+        return forcedPrecision;
+    }
+    if (step > FLOAT_MIN_STEP) {
+        return PREC_FLOAT;
+    }
+    if (step > DOUBLE_MIN_STEP) {
+        return PREC_DOUBLE;
+    }
+    if (step > LONG_DOUBLE_MIN_STEP || fractal != FRACTAL_JULIA) {
+        return PREC_LONG_DOUBLE;
+    }
+    return PREC_PERTURBATION;
+}
+
+precision_t currentPrecision() {
+    return precisionFor(pixelStep());
+}
+
+// Déplace un offset stocké sur deux long double sans perdre les petits pas
+void moveOffset(long double *hi, long double *lo, long double delta) {
+    long double s = *hi + delta;
+    long double bb = s - *hi;
+    long double err = (*hi - (s - bb)) + (delta - bb);
+    long double t = s + (*lo + err);
+    *lo = (*lo + err) - (t - s);
+    *hi = t;
+}
+
+// Recalcule les orbites de référence (centre de l'image et point critique)
+void buildReference() {
+    long double x = ((long double) (IMG_W / 2) / IMG_W * (limitRight - limitLeft) + limitLeft) * zoom;
+    long double y = ((long double) (IMG_H / 2) / IMG_H * (limitBottom - limitTop) + limitTop) * zoom;
+    dd_t zr = add_dd(add_dd(new_dd(x), new_dd(offsetLeft)), new_dd(offsetLeftLo));
+    dd_t zi = add_dd(add_dd(new_dd(y), new_dd(offsetTop)), new_dd(offsetTopLo));
+    free_ref_orbit(refOrbit);
+    free_ref_orbit(critOrbit);
+    refOrbit = new_ref_orbit(zr, zi, new_dd(c.real), new_dd(c.imag), maxIter);
+    critOrbit = new_ref_orbit(new_dd(0.0), new_dd(0.0), new_dd(c.real), new_dd(c.imag), maxIter);
+}
+
+void updateReference() {
+    if (currentPrecision() == PREC_PERTURBATION) {
+        buildReference();
+    }
+}
+
+bool periodCheck = true; // détection des orbites périodiques
+bool verbose = true;     // statistiques à la fin de chaque image
+
+// Seuls les ensembles de Julia se reprennent : ailleurs c change d'un pixel
+// à l'autre et l'orbite rangée ne suffit pas
+bool canResume() {
+    precision_t p = currentPrecision();
+    return (p == PREC_FLOAT || p == PREC_DOUBLE) && !pixelIsC(fractal);
+}
+
+// Calcule n pixels alignés : (x, y), (x + dx, y + dy), (x + 2 dx, y + 2 dy)...
+// its reçoit le nombre brut d'itérations de chaque pixel, zr et zi (s'ils ne
+// sont pas NULL) l'orbite des points qui n'ont pas divergé, quand la
+// précision permet de la reprendre (voir canResume ; sinon ils ne sont pas
+// écrits).
+long juliaSpan(long double x, long double y, long double dx, long double dy, int n, int *its,
+               double *zr, double *zi) {
+    complex z = convert(x, y);
+    long double step = pixelStep();
+    long double dre = step * dx;
+    long double dim = step * dy;
+    long saved = 0;
+    long iters;
+    if (!canResume()) {
+        zr = zi = NULL;
+    }
+    switch (currentPrecision()) {
+      case PREC_FLOAT:
+        iters = escapeSpanFloat(z.real, z.imag, dre, dim, n, c.real, c.imag, maxIter, its, periodCheck, &saved, fractal, zr, zi);
+        break;
+      case PREC_DOUBLE:
+        iters = escapeSpanDouble(z.real, z.imag, dre, dim, n, c.real, c.imag, maxIter, its, periodCheck, &saved, fractal, zr, zi);
+        break;
+      case PREC_PERTURBATION:
+        iters = escapeSpanPerturb(refOrbit, critOrbit, (double) (x - IMG_W / 2) * step,
+                                  (double) (y - IMG_H / 2) * step, dre, dim, n, maxIter, its, periodCheck, &saved);
+        break;
+      case PREC_LONG_DOUBLE:
+      default:
+        iters = escapeSpanLongDouble(z.real, z.imag, dre, dim, n, c.real, c.imag, maxIter, its, periodCheck, &saved,
+                                     fractal);
+        break;
+    }
+    myStats->iters += iters;
+    myStats->saved += saved;
+    return iters;
+}
+
+// Reprend n orbites arrêtées (voir escapeResume) jusqu'au maxIter courant
+long resumeSpan(double *zr, double *zi, int *its, int n) {
+    long saved = 0;
+    long iters;
+    if (currentPrecision() == PREC_FLOAT) {
+        iters = escapeResumeFloat(zr, zi, its, n, c.real, c.imag, maxIter, periodCheck, &saved, fractal);
+    }
+    else {
+        iters = escapeResumeDouble(zr, zi, its, n, c.real, c.imag, maxIter, periodCheck, &saved, fractal);
+    }
+    myStats->iters += iters;
+    myStats->saved += saved;
+    return iters;
+}
+
+void julia(cv::Mat& img) {
+    for (int x = 0; x < IMG_W; x++) {
+        for (int y = 0; y < IMG_H; y++) {
+            int j = juliaDot(convert(x, y), maxIter);
+            cv::Vec3b color(j, j, j);
+            img.at<cv::Vec3b>(cv::Point(x, y)) = color;
+        }
+    }
+}
+
+/* MAIN ***********************************************************************/
+
+cv::Vec3b hsv2bgr(int h, float s, float v) {
+  int r, g, b;
+  int ti = (h / 60) % 6;
+  float f = h / 60.0 - ti;
+  int l = 255 * v * (1 - s);
+  int m = 255 * v * (1 - f * s);
+  int n = 255 * v * (1 - (1 - f) * s);
+  v *= 255;
+  switch (ti) {
+    case 0:
+      return cv::Vec3b(l, n, v);
+    case 1:
+      return cv::Vec3b(l, v, m);
+    case 2:
+      return cv::Vec3b(n, v, l);
+    case 3:
+      return cv::Vec3b(v, m, l);
+    case 4:
+      return cv::Vec3b(v, l, n);
+    default:
+    case 5:
+      return cv::Vec3b(m, l, v);
+  }
+}
+
+/* COLORATION *****************************************************************/
+
+// Les threads ne rangent que le nombre d'itérations dans iterBuf. L'image
+// est coloriée au moment de l'affichage à travers une table donnant la
+// couleur de chaque nombre d'itérations : changer de couleurs ne demande
+// aucun recalcul.
+
+#define LUT_SIZE 256
+#define HUES 360
+#define PALETTE_SIZE (int) (sizeof(palette) / sizeof(palette[0]) / 3)
+
+cv::Vec3b colorLut[COLOR_MODES][LUT_SIZE]; // rampes des modes sans teinte
+cv::Vec3b hueLut[HUES];
+cv::Vec3b *iterLut = NULL; // couleur de chaque nombre d'itérations (0 à maxIter)
+int lutMaxIter = -1;       // paramètres avec lesquels iterLut a été construite
+color_mode_t lutMode = COLOR_MODES;
+int lutOffset = -1;
+
+void initColorLuts() {
+    for (int j = 0; j < LUT_SIZE; j++) {
+        colorLut[BLACK_AND_WHITE][j] = cv::Vec3b(j, j, j);
+        int k = std::min(j, PALETTE_SIZE - 1); // les palettes n'ont que 255 couleurs
+        colorLut[PALETTE1][j] = cv::Vec3b(palette[k*3], palette[k*3+1], palette[k*3+2]);
+        colorLut[PALETTE2][j] = cv::Vec3b(palette2[k*3], palette2[k*3+1], palette2[k*3+2]);
+    }
+    for (int h = 0; h < HUES; h++) {
+        hueLut[h] = hsv2bgr(h, 1.0, 1.0);
+    }
+}
+
+// Remplit lut (iter + 1 cases) avec les couleurs courantes. Ne touche à
+// aucune globale : les rendus hors fenêtre l'appellent depuis leurs threads.
+void buildIterLut(cv::Vec3b *lut, int iter) {
+    for (int it = 0; it <= iter; it++) {
+        int j = (long) it * (LUT_SIZE - 1) / iter; // on met it dans l'intervalle 0 à 255
+        if (colorMode == HUE) {
+            lut[it] = hueLut[(j * HUES / (LUT_SIZE - 1) + offsetColor) % HUES];
+        }
+        else {
+            lut[it] = colorLut[colorMode][j];
+        }
+    }
+}
+
+// Colorie toute l'image à partir du tampon avant (thread d'affichage seulement)
+void recolor() {
+    if (lutMaxIter != maxIter || lutMode != colorMode || lutOffset != offsetColor) {
+        if (lutMaxIter != maxIter) {
+            free(iterLut);
+            iterLut = (cv::Vec3b*) malloc((maxIter + 1) * sizeof(cv::Vec3b));
+        }
+        buildIterLut(iterLut, maxIter);
+        lutMaxIter = maxIter;
+        lutMode = colorMode;
+        lutOffset = offsetColor;
+    }
+    cv::Vec3b *dst = newImg.ptr<cv::Vec3b>(0);
+    const cv::Vec3b *lut = iterLut;
+    int top = maxIter; // le tampon peut encore contenir l'image précédente
+    // le verrou n'est tenu que pour réserver le tampon : presentPass
+    // n'attend jamais la fin du coloriage
+    pthread_mutex_lock(&displayMutex);
+    shownReading = shownFront;
+    const int *its = shownBuf[shownReading];
+    bool final = frontFinal;
+    pthread_mutex_unlock(&displayMutex);
+    for (int i = 0; i < IMG_W * IMG_H; i++) {
+        int it = its[i];
+        dst[i] = lut[it < top ? it : top];
+    }
+    pthread_mutex_lock(&displayMutex);
+    shownReading = -1;
+    pthread_mutex_unlock(&displayMutex);
+    // pixels de bord : moyenne des couleurs de leurs sous-échantillons, une
+    // fois la dernière passe affichée
+    if (__atomic_load_n(&aaPixels, __ATOMIC_RELAXED) == 0 || !final) {
+        return;
+    }
+    int n = aaFrameGrid * aaFrameGrid;
+    for (int i = 0; i < IMG_W * IMG_H; i++) {
+        if (aaIndex[i] == 0) {
+            continue;
+        }
+        int q = aaIndex[i] > 0 ? i : -aaIndex[i] - 1;
+        int tile = (q / IMG_W / tileSize) * tilesX + q % IMG_W / tileSize;
+        const int *its = &aaTileIts[tile][aaIndex[q] - 1];
+        int sum[3] = {n / 2, n / 2, n / 2};
+        for (int k = 0; k < n; k++) {
+            const cv::Vec3b& col = lut[its[k] < top ? its[k] : top];
+            sum[0] += col[0];
+            sum[1] += col[1];
+            sum[2] += col[2];
+        }
+        dst[i] = cv::Vec3b(sum[0] / n, sum[1] / n, sum[2] / n);
+    }
+}
+
+// Range l'orbite du pixel p qui en est à it itérations (zr NULL : rien à reprendre)
+void storeOrbit(int p, int it, const double *zr, const double *zi) {
+    if (zr == NULL || it < maxIter) {
+        orbitIter[p] = ORBIT_DONE;
+    }
+    else if (isnan(*zr)) {
+        orbitIter[p] = ORBIT_PERIODIC;
+    }
+    else {
+        orbitIter[p] = it;
+        orbitRe[p] = *zr;
+        orbitIm[p] = *zi;
+    }
+}
+
+// Range les pixels calculés par juliaSpan. En aperçu (block > 1), chaque
+// pixel remplit le carré block x block qu'il représente. Les orbites ne
+// sont lues que si juliaSpan les a écrites.
+void storeSpan(int x0, int y0, int dx, int dy, int n, const int *its,
+               const double *zr, const double *zi, int block) {
+    if (!canResume()) {
+        zr = zi = NULL;
+    }
+    for (int k = 0; k < n; k++) {
+      int x = x0 + k * dx;
+      int y = y0 + k * dy;
+      storeOrbit(y * IMG_W + x, its[k], zr ? zr + k : NULL, zi ? zi + k : NULL);
+      for (int by = y; by < y + block && by < IMG_H; by++) {
+        for (int bx = x; bx < x + block && bx < IMG_W; bx++) {
+          iterBuf[by * IMG_W + bx] = its[k];
+        }
+      }
+    }
+}
+
+/* MARIANI-SILVER *************************************************************/
+
+// En mode Mariani-Silver, la dernière passe d'une tuile ne calcule que le
+// bord des rectangles : si tout le bord a le même nombre d'itérations, on
+// remplit l'intérieur sans le calculer, sinon on coupe le rectangle en deux.
+// Les pixels de coordonnées paires, connus grâce aux passes précédentes,
+// doivent aussi avoir la même valeur pour qu'on remplisse.
+
+bool marianiSilver = false;
+bool verifyFill = false; // recalcule tout pour compter les pixels mal remplis
+long filledPixels = 0;
+long fillErrors = 0;
+
+// Calcule les pixels encore inconnus du segment de n pixels partant de
+// (x, y) dans la direction (dx, dy) (horizontal ou vertical)
+long computeUnknown(int x, int y, int dx, int dy, int n) {
+    int its[IMG_W > IMG_H ? IMG_W : IMG_H];
+    double zr[IMG_W > IMG_H ? IMG_W : IMG_H];
+    double zi[IMG_W > IMG_H ? IMG_W : IMG_H];
+    int var = dx ? x : y;
+    int end = var + n - 1;
+    int step = 1;
+    // sur une ligne (ou colonne) paire, un pixel sur deux est déjà connu
+    if ((dx ? y : x) % 2 == 0) {
+        var |= 1;
+        step = 2;
+    }
+    if (var > end) {
+        return 0;
+    }
+    int m = (end - var) / step + 1;
+    int px = dx ? var : x;
+    int py = dx ? y : var;
+    long iters = juliaSpan(px, py, dx * step, dy * step, m, its, zr, zi);
+    storeSpan(px, py, dx * step, dy * step, m, its, zr, zi, 1);
+    return iters;
+}
+
+bool uniformRect(int x0, int y0, int x1, int y1, int *v) {
+    int ref = iterBuf[y0 * IMG_W + x0];
+    for (int x = x0; x <= x1; x++) {
+        if (iterBuf[y0 * IMG_W + x] != ref || iterBuf[y1 * IMG_W + x] != ref) {
+            return false;
+        }
+    }
+    for (int y = y0; y <= y1; y++) {
+        if (iterBuf[y * IMG_W + x0] != ref || iterBuf[y * IMG_W + x1] != ref) {
+            return false;
+        }
+    }
+    for (int y = (y0 + 2) & ~1; y < y1; y += 2) {
+        for (int x = (x0 + 2) & ~1; x < x1; x += 2) {
+            if (iterBuf[y * IMG_W + x] != ref) {
+                return false;
+            }
+        }
+    }
+    *v = ref;
+    return true;
+}
+
+// Remplit l'intérieur (inconnu) du rectangle avec v
+long fillRect(int x0, int y0, int x1, int y1, int v) {
+    long filled = 0;
+    for (int y = y0 + 1; y < y1; y++) {
+        int step = 2 - (y & 1);
+        for (int x = (y & 1) ? x0 + 1 : (x0 + 1) | 1; x < x1; x += step) {
+            int p = y * IMG_W + x;
+            iterBuf[p] = v;
+            if (v < maxIter) {
+                orbitIter[p] = ORBIT_DONE;
+            }
+            else { // pas d'orbite calculée : on repartira du début
+                complex z = convert(x, y);
+                orbitIter[p] = 0;
+                orbitRe[p] = z.real;
+                orbitIm[p] = z.imag;
+            }
+            filled++;
+        }
+    }
+    return filled;
+}
+
+// Rectangle [x0, x1] x [y0, y1] (bornes incluses) dont le bord est connu.
+// Retourne false si l'époque a changé.
+bool msRect(int x0, int y0, int x1, int y1, unsigned epoch, long *iters, long *filled) {
+    if (__atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) != epoch) {
+        return false;
+    }
+    if (x1 - x0 < 2 || y1 - y0 < 2) {
+        return true; // pas d'intérieur
+    }
+    int v;
+    if (uniformRect(x0, y0, x1, y1, &v)) {
+        *filled += fillRect(x0, y0, x1, y1, v);
+        return true;
+    }
+    if (x1 - x0 <= 4 || y1 - y0 <= 4) {
+        for (int y = y0 + 1; y < y1; y++) {
+            *iters += computeUnknown(x0 + 1, y, 1, 0, x1 - x0 - 1);
+        }
+        return true;
+    }
+    if (x1 - x0 >= y1 - y0) {
+        int xm = (x0 + x1) / 2;
+        *iters += computeUnknown(xm, y0 + 1, 0, 1, y1 - y0 - 1);
+        return msRect(x0, y0, xm, y1, epoch, iters, filled)
+            && msRect(xm, y0, x1, y1, epoch, iters, filled);
+    }
+    int ym = (y0 + y1) / 2;
+    *iters += computeUnknown(x0 + 1, ym, 1, 0, x1 - x0 - 1);
+    return msRect(x0, y0, x1, ym, epoch, iters, filled)
+        && msRect(x0, ym, x1, y1, epoch, iters, filled);
+}
+
+// Dernière passe d'une tuile en mode Mariani-Silver
+bool msTile(int x0, int y0, int w, int h, unsigned epoch, long *iters) {
+    int x1 = x0 + w - 1;
+    int y1 = y0 + h - 1;
+    long filled = 0;
+
+    *iters += computeUnknown(x0, y0, 1, 0, w);
+    if (h > 1) {
+        *iters += computeUnknown(x0, y1, 1, 0, w);
+    }
+    if (h > 2) {
+        *iters += computeUnknown(x0, y0 + 1, 0, 1, h - 2);
+        if (w > 1) {
+            *iters += computeUnknown(x1, y0 + 1, 0, 1, h - 2);
+        }
+    }
+    if (!msRect(x0, y0, x1, y1, epoch, iters, &filled)) {
+        return false;
+    }
+    __atomic_add_fetch(&filledPixels, filled, __ATOMIC_RELAXED);
+
+    if (verifyFill && filled > 0) {
+        int its[IMG_W];
+        long errors = 0;
+        for (int y = y0; y <= y1; y++) {
+            juliaSpan(x0, y, 1, 0, w, its, NULL, NULL);
+            for (int x = x0; x <= x1; x++) {
+                errors += its[x - x0] != iterBuf[y * IMG_W + x];
+            }
+        }
+        __atomic_add_fetch(&fillErrors, errors, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+/* DEPLACEMENT ***************************************************************/
+
+// Les flèches déplacent la vue d'un nombre entier de pixels : si l'image
+// précédente était complète, on décale iterBuf et seuls les pixels
+// découverts (hors du rectangle known) sont calculés.
+
+int knownX0 = 0;      // rectangle [knownX0, knownX1[ x [knownY0, knownY1[
+int knownY0 = 0;      // des pixels repris de l'image précédente
+int knownX1 = 0;
+int knownY1 = 0;
+
+int panPixels() {
+    return std::max(1L, lroundl(STEP * zoom / pixelStep()));
+}
+
+// Décale une image de IMG_W x IMG_H valeurs de (dx, dy) pixels
+template<typename T>
+void shiftPlane(T *buf, int dx, int dy) {
+    int w = knownX1 - knownX0;
+    if (dy > 0) {
+        for (int y = knownY0; y < knownY1; y++) {
+            memmove(&buf[y * IMG_W + knownX0], &buf[(y + dy) * IMG_W + knownX0 + dx], w * sizeof(T));
+        }
+    }
+    else {
+        for (int y = knownY1 - 1; y >= knownY0; y--) {
+            memmove(&buf[y * IMG_W + knownX0], &buf[(y + dy) * IMG_W + knownX0 + dx], w * sizeof(T));
+        }
+    }
+}
+
+// Décale le contenu de iterBuf (et les orbites) quand la vue avance de
+// (dx, dy) pixels
+void shiftBuffer(int dx, int dy) {
+    knownX0 = std::max(0, -dx);
+    knownX1 = std::min(IMG_W, IMG_W - dx);
+    knownY0 = std::max(0, -dy);
+    knownY1 = std::min(IMG_H, IMG_H - dy);
+    if (knownX0 >= knownX1 || knownY0 >= knownY1) {
+        return;
+    }
+    shiftPlane(iterBuf, dx, dy);
+    shiftPlane(orbitIter, dx, dy);
+    shiftPlane(orbitRe, dx, dy);
+    shiftPlane(orbitIm, dx, dy);
+}
+
+// Déplace la vue de (dx, dy) pixels (aucun thread ne doit calculer).
+// Retourne true si iterBuf a pu être décalé.
+bool pan(int dx, int dy) {
+    long double step = pixelStep();
+    moveOffset(&offsetLeft, &offsetLeftLo, dx * step);
+    moveOffset(&offsetTop, &offsetTopLo, dy * step);
+    if (!frameDone) {
+        return false; // l'image précédente n'était qu'un aperçu
+    }
+    shiftBuffer(dx, dy);
+    return true;
+}
+
+// Calcule les pixels de la tuile qui ne sont pas dans le rectangle known
+bool renderExposed(int x0, int y0, int w, int h, unsigned epoch) {
+    int its[IMG_W];
+    double zr[IMG_W];
+    double zi[IMG_W];
+    long iters = 0;
+    for (int y = y0; y < y0 + h; y++) {
+        if (__atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) != epoch) {
+            return false;
+        }
+        if (y < knownY0 || y >= knownY1) {
+            iters += juliaSpan(x0, y, 1, 0, w, its, zr, zi);
+            storeSpan(x0, y, 1, 0, w, its, zr, zi, 1);
+            continue;
+        }
+        int left = std::min(x0 + w, knownX0) - x0;
+        if (left > 0) {
+            iters += juliaSpan(x0, y, 1, 0, left, its, zr, zi);
+            storeSpan(x0, y, 1, 0, left, its, zr, zi, 1);
+        }
+        int right = std::max(x0, knownX1);
+        if (right < x0 + w) {
+            iters += juliaSpan(right, y, 1, 0, x0 + w - right, its, zr, zi);
+            storeSpan(right, y, 1, 0, x0 + w - right, its, zr, zi, 1);
+        }
+    }
+    if (iters > 0) {
+        myStats->cost = iters;
+    }
+    return true;
+}
+
+/* REPRISE DES ORBITES *******************************************************/
+
+// Quand maxIter augmente, seuls les pixels arrêtés par l'ancien maxIter
+// sont continués, à partir de l'orbite rangée dans orbitRe/orbitIm.
+
+bool resumeTile(int x0, int y0, int w, int h, unsigned epoch) {
+    int its[IMG_W];
+    int xs[IMG_W];
+    double zr[IMG_W];
+    double zi[IMG_W];
+    long iters = 0;
+    for (int y = y0; y < y0 + h; y++) {
+        if (__atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) != epoch) {
+            return false;
+        }
+        // pixels venus du cache sans orbite : recalculés depuis le début
+        for (int x = x0; x < x0 + w; x++) {
+            int n = 0;
+            while (x + n < x0 + w && orbitIter[y * IMG_W + x + n] == ORBIT_UNKNOWN) {
+                n++;
+            }
+            if (n > 0) {
+                iters += juliaSpan(x, y, 1, 0, n, its, zr, zi);
+                storeSpan(x, y, 1, 0, n, its, zr, zi, 1);
+                x += n;
+            }
+        }
+        int m = 0;
+        for (int x = x0; x < x0 + w; x++) {
+            int p = y * IMG_W + x;
+            if (orbitIter[p] == ORBIT_PERIODIC) {
+                iterBuf[p] = std::max(iterBuf[p], maxIter);
+            }
+            else if (orbitIter[p] >= 0 && orbitIter[p] < maxIter) {
+                xs[m] = x;
+                its[m] = orbitIter[p];
+                zr[m] = orbitRe[p];
+                zi[m] = orbitIm[p];
+                m++;
+            }
+        }
+        if (m == 0) {
+            continue;
+        }
+        iters += resumeSpan(zr, zi, its, m);
+        for (int k = 0; k < m; k++) {
+            int p = y * IMG_W + xs[k];
+            iterBuf[p] = its[k];
+            storeOrbit(p, its[k], zr + k, zi + k);
+        }
+    }
+    if (iters > 0) {
+        myStats->cost = iters;
+    }
+    return true;
+}
+
+/* CACHE DE TUILES ***********************************************************/
+
+// Les nombres d'itérations des images terminées sont gardés par tuiles de
+// CACHE_TILE pixels alignées sur une grille fixe du plan (une grille par
+// niveau de zoom). Une clé (c, maxIter, taille de pixel, tuile) ne dépend
+// donc pas de la position de la fenêtre : en revenant sur une vue déjà vue
+// (zoom arrière, aller-retour avec les flèches), les tuiles de calcul
+// couvertes par le cache sont recopiées au lieu d'être recalculées. Les
+// sous-échantillons de l'anticrénelage ne sont pas gardés : sa passe est
+// refaite même sur une vue entièrement relue du cache.
+//
+// Les tuiles les moins récemment utilisées sont évincées au-delà de
+// cacheLimit octets, vers un fichier projeté en mémoire (spill=FILE) si on
+// en a un, sinon définitivement.
+
+#define CACHE_TILE 64
+#define CACHE_BUCKETS 65536
+#define CACHE_DEFAULT_MB 256
+#define SPILL_DEFAULT_MB 1024
+#define CACHE_BYTES (CACHE_TILE * CACHE_TILE * (long) sizeof(int))
+// tuiles du cache qu'un rectangle de la fenêtre peut toucher, au plus
+#define CACHE_SPAN ((IMG_W / CACHE_TILE + 2) * (IMG_H / CACHE_TILE + 2))
+
+typedef struct {
+    long double cRe;
+    long double cIm;
+    long double step;
+    int maxIter;
+    int flags;     // précision, Mariani-Silver, fractale
+    long long tx;  // indices de la tuile dans la grille du niveau
+    long long ty;
+} cache_key_t;
+
+typedef struct cache_entry {
+    cache_key_t key;
+    int x0, y0, x1, y1;        // partie connue de la tuile [x0, x1[ x [y0, y1[
+    int *its;                  // NULL si la tuile est dans le fichier
+    long slot;                 // case du fichier (-1 : en mémoire)
+    struct cache_entry *next;  // même case de la table
+    struct cache_entry *newer; // liste LRU (mémoire ou fichier)
+    struct cache_entry *older;
+} cache_entry_t;
+
+typedef struct {
+    cache_entry_t *newest;
+    cache_entry_t *oldest;
+} lru_t;
+
+long cacheLimit = 0;          // octets en mémoire, 0 : pas de cache
+const char *spillName = NULL;
+long spillLimit = (long) SPILL_DEFAULT_MB << 20;
+int *spillMap = NULL;         // fichier projeté, spillSlots tuiles
+long spillSlots = 0;
+std::vector<long> freeSlots;
+cache_entry_t **cacheTable = NULL;
+lru_t ramLru = {NULL, NULL};
+lru_t diskLru = {NULL, NULL};
+long ramBytes = 0;
+long diskTiles = 0;
+pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Vue de l'image en cours (fixée par startFrame)
+bool cacheView = false;       // vue alignée sur la grille, cache utilisable
+cache_key_t cacheBase;        // clé sans les indices de tuile
+long long cacheOriginX = 0;   // pixel (0, 0) de la fenêtre dans la grille
+long long cacheOriginY = 0;
+char *tileCached = NULL;      // par tuile de calcul : 0 pas cherchée, 1 absente, 2 recopiée
+long frameHits = 0;           // tuiles de calcul recopiées pour l'image en cours
+long frameMisses = 0;
+long cacheHits = 0;           // depuis le lancement
+long cacheMisses = 0;
+
+long long floorDiv(long long a, long long b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Position du centre de la vue en pixels du niveau courant. false si elle
+// n'est pas entière (ou trop grande pour la grille).
+bool viewOrigin(long double *fx, long double *fy) {
+    long double step = pixelStep();
+    *fx = offsetLeft / step + offsetLeftLo / step;
+    *fy = offsetTop / step + offsetTopLo / step;
+    return fabsl(*fx) < 1e15 && fabsl(*fy) < 1e15;
+}
+
+// Après un zoom arrière, le centre peut tomber entre deux pixels du niveau
+// le plus grossier : on le recale d'un demi-pixel pour retrouver la grille.
+void alignView() {
+    long double fx, fy;
+    if (cacheLimit > 0 && viewOrigin(&fx, &fy)) {
+        long double step = pixelStep();
+        moveOffset(&offsetLeft, &offsetLeftLo, (roundl(fx) - fx) * step);
+        moveOffset(&offsetTop, &offsetTopLo, (roundl(fy) - fy) * step);
+    }
+}
+
+unsigned cacheHash(const cache_key_t *k) {
+    double d[3] = {(double) k->cRe, (double) k->cIm, (double) k->step};
+    unsigned long long v[6];
+    memcpy(v, d, sizeof(d));
+    v[3] = (unsigned) k->maxIter | (unsigned long long) k->flags << 32;
+    v[4] = k->tx;
+    v[5] = k->ty;
+    unsigned long long h = 1469598103934665603ULL;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ v[i]) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    return h & (CACHE_BUCKETS - 1);
+}
+
+bool sameKey(const cache_key_t *a, const cache_key_t *b) {
+    return a->tx == b->tx && a->ty == b->ty && a->maxIter == b->maxIter && a->flags == b->flags
+        && a->step == b->step && a->cRe == b->cRe && a->cIm == b->cIm;
+}
+
+void lruUnlink(lru_t *l, cache_entry_t *e) {
+    (e->newer ? e->newer->older : l->newest) = e->older;
+    (e->older ? e->older->newer : l->oldest) = e->newer;
+}
+
+void lruPush(lru_t *l, cache_entry_t *e) {
+    e->newer = NULL;
+    e->older = l->newest;
+    (l->newest ? l->newest->newer : l->oldest) = e;
+    l->newest = e;
+}
+
+cache_entry_t* cacheFind(const cache_key_t *k) {
+    for (cache_entry_t *e = cacheTable[cacheHash(k)]; e; e = e->next) {
+        if (sameKey(&e->key, k)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Retire définitivement une entrée (déjà sortie de sa liste LRU)
+void cacheDrop(cache_entry_t *e) {
+    cache_entry_t **p = &cacheTable[cacheHash(&e->key)];
+    while (*p != e) {
+        p = &(*p)->next;
+    }
+    *p = e->next;
+    free(e->its);
+    free(e);
+}
+
+// Fait passer les tuiles les plus anciennes de la mémoire au fichier (ou
+// les oublie) jusqu'à repasser sous cacheLimit
+void cacheEvict() {
+    while (ramBytes > cacheLimit && ramLru.oldest) {
+        cache_entry_t *e = ramLru.oldest;
+        lruUnlink(&ramLru, e);
+        ramBytes -= CACHE_BYTES;
+        if (!spillMap) {
+            cacheDrop(e);
+            continue;
+        }
+        if (freeSlots.empty()) {
+            cache_entry_t *old = diskLru.oldest;
+            lruUnlink(&diskLru, old);
+            freeSlots.push_back(old->slot);
+            diskTiles--;
+            cacheDrop(old);
+        }
+        e->slot = freeSlots.back();
+        freeSlots.pop_back();
+        memcpy(spillMap + e->slot * CACHE_TILE * CACHE_TILE, e->its, CACHE_BYTES);
+        free(e->its);
+        e->its = NULL;
+        lruPush(&diskLru, e);
+        diskTiles++;
+    }
+}
+
+// Marque l'entrée comme la plus récente, en la ramenant du fichier au besoin
+// (cacheEvict est appelé ensuite, une fois les entrées utilisées)
+void cacheTouch(cache_entry_t *e) {
+    if (e->its) {
+        lruUnlink(&ramLru, e);
+        lruPush(&ramLru, e);
+        return;
+    }
+    e->its = (int*) malloc(CACHE_BYTES);
+    memcpy(e->its, spillMap + e->slot * CACHE_TILE * CACHE_TILE, CACHE_BYTES);
+    lruUnlink(&diskLru, e);
+    freeSlots.push_back(e->slot);
+    diskTiles--;
+    e->slot = -1;
+    lruPush(&ramLru, e);
+    ramBytes += CACHE_BYTES;
+}
+
+void initCache() {
+    cacheLimit = std::max(cacheLimit, CACHE_BYTES);
+    cacheTable = (cache_entry_t**) calloc(CACHE_BUCKETS, sizeof(cache_entry_t*));
+    if (!spillName) {
+        return;
+    }
+    spillSlots = spillLimit / CACHE_BYTES;
+    int fd = open(spillName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || spillSlots <= 0 || ftruncate(fd, spillSlots * CACHE_BYTES) != 0) {
+        fprintf(stderr, "Cannot create the cache file %s, spilling disabled\n", spillName);
+    }
+    else {
+        void *m = mmap(NULL, spillSlots * CACHE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            fprintf(stderr, "Cannot map the cache file %s, spilling disabled\n", spillName);
+        }
+        else {
+            spillMap = (int*) m;
+            for (long k = spillSlots - 1; k >= 0; k--) {
+                freeSlots.push_back(k);
+            }
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void freeCache() {
+    if (!cacheTable) {
+        return;
+    }
+    for (int b = 0; b < CACHE_BUCKETS; b++) {
+        for (cache_entry_t *e = cacheTable[b]; e; ) {
+            cache_entry_t *next = e->next;
+            free(e->its);
+            free(e);
+            e = next;
+        }
+    }
+    free(cacheTable);
+    cacheTable = NULL;
+    if (spillMap) {
+        munmap(spillMap, spillSlots * CACHE_BYTES);
+        unlink(spillName);
+        spillMap = NULL;
+    }
+}
+
+// Paramètres de l'image qui commence (thread principal, aucun calcul en cours)
+void cacheStartFrame() {
+    long double fx, fy;
+    cacheView = cacheTable && viewOrigin(&fx, &fy) && fx == roundl(fx) && fy == roundl(fy);
+    if (!cacheView) {
+        return;
+    }
+    cacheBase.cRe = pixelIsC(fractal) ? 0.0 : c.real; // c ne sert pas quand le pixel est c
+    cacheBase.cIm = pixelIsC(fractal) ? 0.0 : c.imag;
+    cacheBase.step = pixelStep();
+    cacheBase.maxIter = maxIter;
+    cacheBase.flags = currentPrecision() | (marianiSilver ? 0x100 : 0) | fractal << 16;
+    cacheOriginX = (long long) roundl(fx) - IMG_W / 2;
+    cacheOriginY = (long long) roundl(fy) - IMG_H / 2;
+}
+
+// Recopie le rectangle (x0, y0, w, h) de la fenêtre depuis le cache s'il y
+// est entièrement. Retourne false sinon (rien n'est modifié).
+bool cacheLookup(int x0, int y0, int w, int h) {
+    long long gx0 = cacheOriginX + x0;
+    long long gy0 = cacheOriginY + y0;
+    long long tx0 = floorDiv(gx0, CACHE_TILE);
+    long long ty0 = floorDiv(gy0, CACHE_TILE);
+    long long tx1 = floorDiv(gx0 + w - 1, CACHE_TILE);
+    long long ty1 = floorDiv(gy0 + h - 1, CACHE_TILE);
+    cache_entry_t *found[CACHE_SPAN];
+    cache_key_t k = cacheBase;
+
+    pthread_mutex_lock(&cacheMutex);
+    int n = 0;
+    for (k.ty = ty0; k.ty <= ty1; k.ty++) {
+        for (k.tx = tx0; k.tx <= tx1; k.tx++) {
+            cache_entry_t *e = cacheFind(&k);
+            // partie de la tuile couverte par le rectangle
+            int ax = std::max(gx0, k.tx * CACHE_TILE) - k.tx * CACHE_TILE;
+            int ay = std::max(gy0, k.ty * CACHE_TILE) - k.ty * CACHE_TILE;
+            int bx = std::min(gx0 + w, (k.tx + 1) * CACHE_TILE) - k.tx * CACHE_TILE;
+            int by = std::min(gy0 + h, (k.ty + 1) * CACHE_TILE) - k.ty * CACHE_TILE;
+            if (!e || ax < e->x0 || ay < e->y0 || bx > e->x1 || by > e->y1) {
+                pthread_mutex_unlock(&cacheMutex);
+                return false;
+            }
+            found[n++] = e;
+        }
+    }
+    n = 0;
+    for (long long ty = ty0; ty <= ty1; ty++) {
+        for (long long tx = tx0; tx <= tx1; tx++) {
+            cache_entry_t *e = found[n++];
+            cacheTouch(e);
+            long long ax = std::max(gx0, tx * CACHE_TILE);
+            long long ay = std::max(gy0, ty * CACHE_TILE);
+            long long bx = std::min(gx0 + w, (tx + 1) * CACHE_TILE);
+            long long by = std::min(gy0 + h, (ty + 1) * CACHE_TILE);
+            for (long long gy = ay; gy < by; gy++) {
+                int p = (gy - cacheOriginY) * IMG_W + (ax - cacheOriginX);
+                const int *src = e->its + (gy - ty * CACHE_TILE) * CACHE_TILE + (ax - tx * CACHE_TILE);
+                for (int k = 0; k < bx - ax; k++) {
+                    iterBuf[p + k] = src[k];
+                    orbitIter[p + k] = src[k] < maxIter ? ORBIT_DONE : ORBIT_UNKNOWN;
+                }
+            }
+        }
+    }
+    cacheEvict();
+    pthread_mutex_unlock(&cacheMutex);
+    return true;
+}
+
+// Mémoire et fichier occupés (les threads de calcul évincent à tout moment)
+void cacheUsage(double *ramMb, double *diskMb) {
+    pthread_mutex_lock(&cacheMutex);
+    *ramMb = ramBytes / 1048576.0;
+    *diskMb = diskTiles * CACHE_BYTES / 1048576.0;
+    pthread_mutex_unlock(&cacheMutex);
+}
+
+// Range l'image terminée (thread principal, aucun calcul en cours)
+void cacheStore() {
+    if (!cacheView) {
+        return;
+    }
+    cache_key_t k = cacheBase;
+    int top = cacheBase.maxIter; // maxIter a pu baisser depuis (touche r)
+    pthread_mutex_lock(&cacheMutex);
+    for (k.ty = floorDiv(cacheOriginY, CACHE_TILE); k.ty * CACHE_TILE < cacheOriginY + IMG_H; k.ty++) {
+        for (k.tx = floorDiv(cacheOriginX, CACHE_TILE); k.tx * CACHE_TILE < cacheOriginX + IMG_W; k.tx++) {
+            // partie de la tuile visible dans la fenêtre
+            int wx0 = std::max(cacheOriginX, k.tx * CACHE_TILE) - k.tx * CACHE_TILE;
+            int wy0 = std::max(cacheOriginY, k.ty * CACHE_TILE) - k.ty * CACHE_TILE;
+            int wx1 = std::min(cacheOriginX + IMG_W, (k.tx + 1) * CACHE_TILE) - k.tx * CACHE_TILE;
+            int wy1 = std::min(cacheOriginY + IMG_H, (k.ty + 1) * CACHE_TILE) - k.ty * CACHE_TILE;
+            int x0 = wx0, y0 = wy0, x1 = wx1, y1 = wy1;
+            cache_entry_t *e = cacheFind(&k);
+            if (!e) {
+                e = (cache_entry_t*) calloc(1, sizeof(cache_entry_t));
+                e->key = k;
+                e->its = (int*) malloc(CACHE_BYTES);
+                e->slot = -1;
+                unsigned b = cacheHash(&k);
+                e->next = cacheTable[b];
+                cacheTable[b] = e;
+                lruPush(&ramLru, e);
+                ramBytes += CACHE_BYTES;
+            }
+            else {
+                cacheTouch(e);
+                if (e->x0 == x0 && e->x1 == x1 && e->y0 <= y1 && y0 <= e->y1) {
+                    y0 = std::min(y0, e->y0);  // l'union est encore un rectangle
+                    y1 = std::max(y1, e->y1);
+                }
+                else if (e->y0 == y0 && e->y1 == y1 && e->x0 <= x1 && x0 <= e->x1) {
+                    x0 = std::min(x0, e->x0);
+                    x1 = std::max(x1, e->x1);
+                }
+                else if ((x1 - x0) * (y1 - y0) < (e->x1 - e->x0) * (e->y1 - e->y0)) {
+                    continue;  // on garde la plus grande partie connue
+                }
+            }
+            long long gx = k.tx * CACHE_TILE - cacheOriginX;
+            long long gy = k.ty * CACHE_TILE - cacheOriginY;
+            for (int y = wy0; y < wy1; y++) {
+                const int *src = &iterBuf[(gy + y) * IMG_W + gx];
+                for (int x = wx0; x < wx1; x++) {
+                    e->its[y * CACHE_TILE + x] = std::min(src[x], top);
+                }
+            }
+            e->x0 = x0;
+            e->y0 = y0;
+            e->x1 = x1;
+            e->y1 = y1;
+        }
+    }
+    cacheEvict();
+    pthread_mutex_unlock(&cacheMutex);
+}
+
+// Tuile de calcul déjà recopiée depuis le cache pour cette image, ou
+// recopiée maintenant si possible
+bool tileFromCache(int tile, int x0, int y0, int w, int h) {
+    if (!cacheView || frameMode == FRAME_RESUME || tileCached[tile] == 1) {
+        return false;
+    }
+    if (tileCached[tile] == 2) {
+        return true;
+    }
+    if (frameMode == FRAME_PAN && x0 >= knownX0 && x0 + w <= knownX1 && y0 >= knownY0 && y0 + h <= knownY1) {
+        return false; // rien à calculer de toute façon
+    }
+    bool hit = cacheLookup(x0, y0, w, h);
+    tileCached[tile] = hit ? 2 : 1;
+    __atomic_add_fetch(hit ? &frameHits : &frameMisses, 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+/* SYMETRIE ******************************************************************/
+
+// L'ensemble de Julia de z² + c (ou z⁴ + c) est symétrique par z -> -z, et
+// z et -z ont le même nombre d'itérations (et la même orbite dès la
+// première). Mandelbrot et Tricorn sont symétriques par conjugaison : c et
+// conj(c) ont des orbites conjuguées. Quand l'image contient des paires de
+// pixels symétriques (vue centrée sur l'origine ou l'axe réel, ou qui les
+// contient), on ne calcule que l'une des deux moitiés du recouvrement : les
+// tuiles entièrement dans l'autre moitié sont sautées et, à la fin de chaque
+// passe, cette moitié est recopiée en miroir.
+
+bool symmetry = true;
+bool symView = false;  // l'image en cours a une partie recopiée
+bool symConj = false;  // symétrie par conjugaison (même colonne)
+int mirrorX = 0;       // le symétrique de (x, y) est (mirrorX - x, mirrorY - y),
+int mirrorY = 0;       // ou (x, mirrorY - y) par conjugaison
+int symX0 = 0;         // partie recopiée : colonnes [symX0, symX1],
+int symX1 = -1;        // lignes ]mirrorY / 2, symY1] et, si mirrorY est
+int symY1 = -1;        // pair, la moitié droite de la ligne mirrorY / 2
+long mirroredPixels = 0;
+
+// Cherche les paires de pixels symétriques de la vue (thread principal)
+void symStartFrame() {
+    long double fx, fy;
+    symView = false;
+    mirroredPixels = 0;
+    symConj = fractal == FRACTAL_MANDELBROT || fractal == FRACTAL_TRICORN;
+    if (!symmetry || (!symConj && fractal != FRACTAL_JULIA && fractal != FRACTAL_JULIA4)) {
+        return;
+    }
+    if (!viewOrigin(&fx, &fy) || (!symConj && 2 * fx != roundl(2 * fx)) || 2 * fy != roundl(2 * fy)) {
+        return;
+    }
+    // z(x) = (x - IMG_W / 2 + fx) * pas, donc -z(x) = z(IMG_W - 2 fx - x)
+    long long mx = symConj ? IMG_W - 1 : IMG_W - (long long) roundl(2 * fx);
+    long long my = IMG_H - (long long) roundl(2 * fy);
+    if (mx < 0 || mx > 2 * IMG_W - 2 || my < 0 || my > 2 * IMG_H - 2) {
+        return;
+    }
+    mirrorX = mx;
+    mirrorY = my;
+    symX0 = symConj ? 0 : std::max(0, mirrorX - IMG_W + 1);
+    symX1 = symConj ? IMG_W - 1 : std::min(IMG_W - 1, mirrorX);
+    symY1 = std::min(IMG_H - 1, mirrorY);
+    symView = true;
+}
+
+// Tuile entièrement dans la partie recopiée
+bool mirroredTile(int x0, int y0, int w, int h) {
+    return symView && x0 >= symX0 && x0 + w - 1 <= symX1 && y0 > mirrorY / 2 && y0 + h - 1 <= symY1;
+}
+
+// Recopie une ligne (ou une demi-ligne) en miroir
+void mirrorRow(int y, int x0, int x1, bool orbits) {
+    int src = (mirrorY - y) * IMG_W + (symConj ? 0 : mirrorX);
+    int dir = symConj ? 1 : -1;
+    for (int x = x0; x <= x1; x++) {
+        int p = y * IMG_W + x;
+        int q = src + dir * x;
+        iterBuf[p] = iterBuf[q];
+        if (orbits) {
+            orbitIter[p] = orbitIter[q];
+            if (symConj) {
+                orbitRe[p] = orbitRe[q];
+                orbitIm[p] = -orbitIm[q];
+            }
+            else {
+                orbitRe[p] = orbitIter[q] == 0 ? -orbitRe[q] : orbitRe[q]; // orbite pas encore commencée : -z
+                orbitIm[p] = orbitIter[q] == 0 ? -orbitIm[q] : orbitIm[q];
+            }
+        }
+    }
+    mirroredPixels += x1 - x0 + 1;
+}
+
+// Fin d'une passe : remplit la partie recopiée. Les orbites ne servent
+// qu'après la dernière passe.
+void mirrorFill(bool orbits) {
+    if (!symView) {
+        return;
+    }
+    mirroredPixels = 0;
+    for (int y = mirrorY / 2 + 1; y <= symY1; y++) {
+        mirrorRow(y, symX0, symX1, orbits);
+    }
+    // par conjugaison, la ligne de l'axe est son propre miroir
+    if (mirrorY % 2 == 0 && !symConj) {
+        mirrorRow(mirrorY / 2, std::max(symX0, mirrorX / 2 + 1), symX1, orbits);
+    }
+}
+
+/* ANTICRENELAGE *************************************************************/
+
+// Passe supplémentaire, après la pleine résolution : seuls les pixels dont
+// le nombre d'itérations s'écarte de plus de aaThreshold de celui d'un
+// voisin (le bord de l'ensemble, les limites entre bandes de couleur) sont
+// recalculés en aaGrid x aaGrid sous-échantillons. Chaque ligne de la
+// grille passe par juliaSpan, décalée d'un tirage pseudo-aléatoire (le
+// même d'une image à l'autre) en x et en y. recolor
+// affiche la moyenne des couleurs des sous-échantillons : changer de
+// couleurs ne demande pas de recalcul. Les tuiles recopiées par symétrie
+// reprennent les sous-échantillons de leurs symétriques (leur moyenne ne
+// dépend pas de l'ordre).
+
+#define AA_MAX_GRID 8     // 64 sous-échantillons
+#define AA_DEFAULT_GRID 4 // 16 sous-échantillons
+#define AA_THRESHOLD 2
+
+bool antialias = false;
+int aaGrid = AA_DEFAULT_GRID;
+int aaThreshold = AA_THRESHOLD;
+long aaSamples = 0;  // sous-échantillons calculés dans l'image en cours
+
+// Option aa=N : N sous-échantillons (arrondi à un carré de 4 à 64), 0 pour
+// désactiver
+void setAntialias(int n) {
+    antialias = n > 0;
+    if (antialias) {
+        aaGrid = std::max(2, std::min(AA_MAX_GRID, (int) lround(sqrt((double) n))));
+    }
+}
+
+unsigned aaHash(unsigned p, unsigned j) {
+    unsigned h = p * 0x9e3779b1u ^ (j + 1) * 0x85ebca6bu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Début d'image. aaIndex et aaTileIts ne sont relus qu'une fois la passe
+// terminée, qui les a réécrits pour toutes les tuiles.
+void aaStartFrame() {
+    aaPixels = 0;
+    aaSamples = 0;
+    aaFrameGrid = antialias ? aaGrid : 0;
+}
+
+// Le pixel (x, y) est sur un bord
+bool aaEdge(int x, int y) {
+    int it = iterBuf[y * IMG_W + x];
+    for (int ny = std::max(0, y - 1); ny <= std::min(IMG_H - 1, y + 1); ny++) {
+        for (int nx = std::max(0, x - 1); nx <= std::min(IMG_W - 1, x + 1); nx++) {
+            if (abs(iterBuf[ny * IMG_W + nx] - it) > aaThreshold) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Raffine les pixels de bord d'une tuile. Chaque suite de pixels de bord
+// d'une ligne partage ses décalages : la ligne j de leurs grilles est un
+// seul segment, assez long pour remplir les vecteurs des noyaux. Retourne
+// false si l'époque a changé.
+bool aaTile(int tile, int x0, int y0, int w, int h, unsigned epoch) {
+    std::vector<int>& out = aaTileIts[tile];
+    out.clear();
+    if (mirroredTile(x0, y0, w, h)) {
+        return true; // voir aaMirrorFill
+    }
+    int g = aaFrameGrid;
+    long double sub = 1.0L / g;
+    std::vector<int> its(w * g);
+    long pixels = 0;
+    for (int y = y0; y < y0 + h; y++) {
+        if (__atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) != epoch) {
+            return false;
+        }
+        for (int x = x0; x < x0 + w; ) {
+            if (!aaEdge(x, y)) {
+                aaIndex[y * IMG_W + x++] = 0;
+                continue;
+            }
+            int n = 1;
+            while (x + n < x0 + w && aaEdge(x + n, y)) {
+                n++;
+            }
+            size_t base = out.size();
+            out.resize(base + (size_t) n * g * g);
+            // le pixel (x, y) couvre [x - 1/2, x + 1/2] x [y - 1/2, y + 1/2]
+            for (int j = 0; j < g; j++) {
+                unsigned r = aaHash(y * IMG_W + x, j);
+                long double jx = (r & 0xffff) / 65536.0L;
+                long double jy = (r >> 16) / 65536.0L;
+                juliaSpan(x - 0.5L + jx * sub, y - 0.5L + (j + jy) * sub, sub, 0.0L, n * g, its.data(), NULL, NULL);
+                for (int k = 0; k < n; k++) {
+                    memcpy(&out[base + ((size_t) k * g + j) * g], &its[k * g], g * sizeof(int));
+                }
+            }
+            for (int k = 0; k < n; k++) {
+                aaIndex[y * IMG_W + x + k] = base + (size_t) k * g * g + 1;
+            }
+            pixels += n;
+            x += n;
+        }
+    }
+    __atomic_add_fetch(&aaPixels, pixels, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&aaSamples, pixels * g * g, __ATOMIC_RELAXED);
+    return true;
+}
+
+// Fin de la passe : les pixels des tuiles recopiées renvoient à leurs
+// symétriques
+void aaMirrorFill() {
+    long pixels = 0;
+    for (int t = 0; t < nbTiles; t++) {
+        int x0 = (t % tilesX) * tileSize;
+        int y0 = (t / tilesX) * tileSize;
+        int w = std::min(tileSize, IMG_W - x0);
+        int h = std::min(tileSize, IMG_H - y0);
+        if (!mirroredTile(x0, y0, w, h)) {
+            continue;
+        }
+        for (int y = y0; y < y0 + h; y++) {
+            for (int x = x0; x < x0 + w; x++) {
+                int q = (mirrorY - y) * IMG_W + (symConj ? x : mirrorX - x);
+                aaIndex[y * IMG_W + x] = aaIndex[q] > 0 ? -q - 1 : 0;
+                pixels += aaIndex[q] > 0;
+            }
+        }
+    }
+    __atomic_add_fetch(&aaPixels, pixels, __ATOMIC_RELAXED);
+}
+
+/* PRESENTATION **************************************************************/
+
+// Les threads de calcul ne touchent pas à l'image affichée. À la fin de
+// chaque passe, le dernier thread recopie iterBuf dans un tampon que
+// l'affichage ne lit pas (ni l'avant, ni celui en cours de coloriage, d'où
+// trois tampons), en fait le tampon avant et réveille l'affichage : une
+// passe terminée est affichée tout de suite, sans déchirure et sans
+// attendre le thread d'affichage, et rien n'est recolorié tant qu'aucune
+// passe n'arrive. HighGUI ne lit le clavier que dans waitKey, d'où une
+// attente d'au plus KEY_POLL_MS entre deux lectures.
+//
+// Le thread principal mesure le délai entre une touche et l'affichage de
+// la première passe qui en tient compte, et la durée de chaque image
+// jusqu'à l'affichage de sa dernière passe ('h' affiche les histogrammes).
+
+#define KEY_POLL_MS 5
+#define HIST_BUCKETS 64  // 4 par octave à partir de HIST_MIN_MS
+#define HIST_MIN_MS 0.1
+
+typedef struct {
+    long count[HIST_BUCKETS];
+    long n;
+    double sum;
+    double max;
+} histogram_t;
+
+pthread_cond_t presentCond = PTHREAD_COND_INITIALIZER;
+bool presenting = false;   // une fenêtre affiche les passes (pas en benchmark)
+unsigned presentSeq = 0;   // passes échangées vers le tampon avant
+histogram_t latencyHist;   // touche -> première passe affichée qui en tient compte (ms)
+histogram_t frameHist;     // début de l'image -> sa dernière passe affichée (ms)
+double lastLatency = -1.0; // dernières mesures, pour dumpStats
+double lastPresent = -1.0;
+
+// Fin d'une passe (dernier thread, mutex tenu, plus aucune tuile en cours) ;
+// last : c'est la dernière de l'image
+void presentPass(bool last) {
+    if (!presenting) {
+        return;
+    }
+    // seuls les threads de calcul changent shownFront ; l'affichage ne
+    // peut ensuite réserver que shownFront, jamais back
+    pthread_mutex_lock(&displayMutex);
+    int back = 0;
+    while (back == shownFront || back == shownReading) {
+        back++;
+    }
+    pthread_mutex_unlock(&displayMutex);
+    memcpy(shownBuf[back], iterBuf, sizeof(iterBuf));
+    pthread_mutex_lock(&displayMutex);
+    shownFront = back;
+    frontFinal = last;
+    presentSeq++;
+    pthread_cond_signal(&presentCond);
+    pthread_mutex_unlock(&displayMutex);
+}
+
+// Début d'une image (thread principal) : les sous-échantillons de la
+// précédente vont être réécrits
+void presentStartFrame() {
+    pthread_mutex_lock(&displayMutex);
+    frontFinal = false;
+    pthread_mutex_unlock(&displayMutex);
+    lastLatency = -1.0;
+    lastPresent = -1.0;
+}
+
+// Attend, au plus ms millisecondes, qu'une passe plus récente que seen soit
+// échangée. Retourne presentSeq et, dans final, frontFinal.
+unsigned waitPresent(unsigned seen, int ms, bool *final) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += ms * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+    pthread_mutex_lock(&displayMutex);
+    while (presentSeq == seen && pthread_cond_timedwait(&presentCond, &displayMutex, &ts) == 0) {
+    }
+    unsigned seq = presentSeq;
+    *final = frontFinal;
+    pthread_mutex_unlock(&displayMutex);
+    return seq;
+}
+
+// Borne haute du seau k
+double histBound(int k) {
+    return HIST_MIN_MS * pow(2.0, k / 4.0);
+}
+
+void histAdd(histogram_t *h, double ms) {
+    int k = ms <= HIST_MIN_MS ? 0 : std::min(HIST_BUCKETS - 1, (int) ceil(4 * log2(ms / HIST_MIN_MS)));
+    h->count[k]++;
+    h->n++;
+    h->sum += ms;
+    h->max = std::max(h->max, ms);
+}
+
+// Quantile q (0 à 1), à la largeur d'un seau près
+double histQuantile(const histogram_t *h, double q) {
+    long seen = 0;
+    for (int k = 0; k < HIST_BUCKETS; k++) {
+        seen += h->count[k];
+        if (seen > 0 && seen >= q * h->n) {
+            return std::min(histBound(k), h->max);
+        }
+    }
+    return h->max;
+}
+
+void printHistogram(const char *name, const histogram_t *h) {
+    printf("%s: %ld samples", name, h->n);
+    if (h->n == 0) {
+        printf("\n");
+        return;
+    }
+    printf(", mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f\n", h->sum / h->n,
+           histQuantile(h, 0.5), histQuantile(h, 0.95), histQuantile(h, 0.99), h->max);
+    int first = 0;
+    int last = HIST_BUCKETS - 1;
+    long top = 0;
+    while (h->count[first] == 0) {
+        first++;
+    }
+    while (h->count[last] == 0) {
+        last--;
+    }
+    for (int k = first; k <= last; k++) {
+        top = std::max(top, h->count[k]);
+    }
+    for (int k = first; k <= last; k++) {
+        printf("  <= %8.2f ms %6ld %.*s\n", histBound(k), h->count[k], (int) (h->count[k] * 40 / top),
+               "########################################");
+    }
+}
+
+/* DISTRIBUTION DES TUILES ****************************************************/
+
+void initTiles() {
+    tilesX = (IMG_W + tileSize - 1) / tileSize;
+    tilesY = (IMG_H + tileSize - 1) / tileSize;
+    nbTiles = tilesX * tilesY;
+    free(tileOrder);
+    free(tileCost);
+    free(tileIters);
+    free(tileCached);
+    free(tileRecords);
+    free(passStats.tileIters);
+    free(shownStats.tileIters);
+    tileOrder = (int*) malloc(nbTiles * sizeof(int));
+    tileCached = (char*) calloc(nbTiles, 1);
+    tileCost = (long*) malloc(nbTiles * sizeof(long));
+    tileIters = (long*) calloc(nbTiles, sizeof(long));
+    passStats.tileIters = (long*) calloc(nbTiles, sizeof(long));
+    shownStats.tileIters = (long*) calloc(nbTiles, sizeof(long));
+    recordStride = nbTiles + RECORD_GAP;
+    tileRecords = (tile_record_t*) malloc((size_t) nbThreads * recordStride * sizeof(tile_record_t));
+    for (int t = 0; workerStats && t < nbThreads; t++) {
+        workerStats[t].records = 0;
+    }
+    delete[] aaTileIts;
+    aaTileIts = new std::vector<int>[nbTiles];
+    aaPixels = 0;
+    // Sans historique, on estime que les tuiles du centre (souvent à
+    // l'intérieur de l'ensemble) sont les plus chères.
+    for (int t = 0; t < nbTiles; t++) {
+        long dx = (t % tilesX) * 2 + 1 - tilesX;
+        long dy = (t / tilesX) * 2 + 1 - tilesY;
+        tileOrder[t] = t;
+        tileCost[t] = -(dx * dx + dy * dy);
+    }
+}
+
+bool costlier(int a, int b) {
+    return tileCost[a] > tileCost[b] || (tileCost[a] == tileCost[b] && a < b);
+}
+
+// Reporte dans tileIters et tileCost les tuiles traitées par les threads
+// (aucun thread ne doit être en train d'en ajouter)
+void mergeTileRecords() {
+    for (int t = 0; t < nbThreads; t++) {
+        const tile_record_t *r = &tileRecords[(size_t) t * recordStride];
+        for (int k = 0; k < workerStats[t].records; k++) {
+            tileIters[r[k].tile] += r[k].iters;
+            if (r[k].cost >= 0) {
+                tileCost[r[k].tile] = r[k].cost;
+            }
+        }
+        workerStats[t].records = 0;
+    }
+}
+
+// Trie les tuiles par coût décroissant (d'après la dernière image) pour
+// que les plus longues partent en premier et que la fin d'image soit
+// équilibrée entre les threads.
+void orderTiles() {
+    std::sort(tileOrder, tileOrder + nbTiles, costlier);
+}
+
+// Calcule une passe d'une tuile. La passe p ne calcule que les pixels
+// de la grille de pas 8 >> p qui n'ont pas été calculés par les passes
+// précédentes. Retourne false si l'époque a changé entre-temps.
+bool renderTile(int tile, int pass, unsigned epoch) {
+    int x0 = (tile % tilesX) * tileSize;
+    int y0 = (tile / tilesX) * tileSize;
+    int w = std::min(tileSize, IMG_W - x0);
+    int h = std::min(tileSize, IMG_H - y0);
+    int s = (1 << (PASSES - 1)) >> pass;
+    int its[IMG_W];
+    double zr[IMG_W];
+    double zi[IMG_W];
+    long iters = 0;
+
+    if (pass == AA_PASS) {
+        return aaTile(tile, x0, y0, w, h, epoch);
+    }
+    if (mirroredTile(x0, y0, w, h) || tileFromCache(tile, x0, y0, w, h)) {
+        return true;
+    }
+    if (frameMode == FRAME_PAN) {
+        return renderExposed(x0, y0, w, h, epoch);
+    }
+    if (frameMode == FRAME_RESUME) {
+        return resumeTile(x0, y0, w, h, epoch);
+    }
+    if (marianiSilver && pass == PASSES - 1) {
+        if (!msTile(x0, y0, w, h, epoch, &iters)) {
+            return false;
+        }
+        myStats->cost = iters;
+        return true;
+    }
+
+    for (int y = y0; y < y0 + h; y += s) {
+        if (__atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) != epoch) {
+            return false;
+        }
+        // sur les lignes déjà visitées, seuls les pixels impairs sont nouveaux
+        int start = 0;
+        int dx = s;
+        if (pass > 0 && (y - y0) % (2 * s) == 0) {
+            start = s;
+            dx = 2 * s;
+        }
+        int n = (w - start + dx - 1) / dx;
+        if (n <= 0) {
+            continue;
+        }
+        iters += juliaSpan(x0 + start, y, dx, 0, n, its, zr, zi);
+        storeSpan(x0 + start, y, dx, 0, n, its, zr, zi, s);
+    }
+    myStats->cost = iters;
+    return true;
+}
+
+// Publie les tuiles de la passe pass (mutex tenu)
+void publishPass(int pass) {
+    curPass = pass;
+    tilesDone = 0;
+    __atomic_store_n(&ticket, (unsigned long long) workEpoch << 32, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&cond);
+}
+
+// Recopie les compteurs dans passStats (sous mutex, aucun thread ne
+// calcule de tuile de l'image en cours)
+void snapshotStats(bool done) {
+    passStats.mode = frameMode;
+    passStats.done = done;
+    passStats.start = frameStart;
+    passStats.end = done ? frameEnd : now();
+    passStats.iters = 0;
+    passStats.saved = 0;
+    for (int t = 0; t < activeThreads; t++) {
+        passStats.iters += workerStats[t].iters;
+        passStats.saved += workerStats[t].saved;
+    }
+    passStats.hits = __atomic_load_n(&frameHits, __ATOMIC_RELAXED);
+    passStats.misses = __atomic_load_n(&frameMisses, __ATOMIC_RELAXED);
+    passStats.totalHits = cacheHits;
+    passStats.totalMisses = cacheMisses;
+    passStats.threads = activeThreads;
+    memcpy(passStats.workers, workerStats, activeThreads * sizeof(worker_stats_t));
+    memcpy(passStats.tileIters, tileIters, nbTiles * sizeof(long));
+}
+
+// Appelé par le thread qui termine la dernière tuile d'une passe
+void passFinished(unsigned epoch) {
+    pthread_mutex_lock(&mutex);
+    if (workEpoch == epoch && curPass < PASSES) {
+        mirrorFill(curPass == PASSES - 1);
+    }
+    else if (workEpoch == epoch) {
+        aaMirrorFill();
+    }
+    bool last = curPass + 1 >= PASSES && !(curPass + 1 == AA_PASS && aaFrameGrid > 0);
+    if (workEpoch == epoch) {
+        mergeTileRecords(); // toutes les tuiles de la passe sont rangées
+        presentPass(last);
+    }
+    if (workEpoch == epoch && !last) {
+        snapshotStats(false);
+        orderTiles(); // les coûts de cette passe prédisent ceux de la suivante
+        __atomic_add_fetch(&workEpoch, 1, __ATOMIC_SEQ_CST);
+        publishPass(curPass + 1);
+    }
+    else if (workEpoch == epoch) {
+        frameEnd = now();
+        frameIters = 0;
+        frameSaved = 0;
+        for (int t = 0; t < activeThreads; t++) {
+            frameIters += workerStats[t].iters;
+            frameSaved += workerStats[t].saved;
+        }
+        frameCount++;
+        cacheHits += frameHits;
+        cacheMisses += frameMisses;
+        snapshotStats(true);
+        __atomic_store_n(&frameDone, true, __ATOMIC_SEQ_CST);
+        pthread_cond_broadcast(&doneCond);
+        if (verbose) {
+            printf("Frame done: %ld iterations", frameIters);
+            if (periodCheck) {
+                printf(", %ld saved by periodicity checking", frameSaved);
+            }
+            printf("\n");
+            if (marianiSilver && frameMode != FRAME_AA) { // FRAME_AA ne remplit ni ne recopie rien
+                printf("Mariani-Silver: %ld pixels filled", filledPixels);
+                if (verifyFill) {
+                    printf(", %ld differ from brute force", fillErrors);
+                }
+                printf("\n");
+            }
+            if (symView && frameMode != FRAME_AA) {
+                printf("Symmetry: %ld pixels mirrored\n", mirroredPixels);
+            }
+            if (aaFrameGrid > 0) {
+                printf("Antialiasing: %ld edge pixels (%.1f%%), %ld samples computed\n",
+                       aaPixels, aaPixels * 100.0 / (IMG_W * IMG_H), aaSamples);
+            }
+            if (cacheView) {
+                double ramMb, diskMb;
+                cacheUsage(&ramMb, &diskMb);
+                printf("Cache: %ld tiles copied, %ld computed (%ld / %ld in total), %.1f MB in memory, %.1f MB on disk\n",
+                       frameHits, frameMisses, cacheHits, cacheHits + cacheMisses, ramMb, diskMb);
+            }
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// Abandonne l'image en cours : les threads lâchent leur tuile à la ligne
+// suivante. Au retour, plus aucun thread ne lit les paramètres de l'image.
+void cancelFrame() {
+    pthread_mutex_lock(&mutex);
+    __atomic_add_fetch(&workEpoch, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&mutex);
+    while (__atomic_load_n(&inFlight, __ATOMIC_SEQ_CST) > 0) {
+        sched_yield();
+    }
+}
+
+// Lance le calcul de l'image. Après un déplacement (FRAME_PAN) ou une
+// hausse de maxIter (FRAME_RESUME), seuls les pixels manquants sont
+// calculés, directement en pleine résolution. FRAME_AA ne lance que la
+// passe d'anticrénelage sur iterBuf, qui doit contenir une image terminée.
+void startFrame(frame_mode_t mode) {
+    mergeTileRecords(); // coûts des tuiles finies d'une image abandonnée
+    filledPixels = 0;
+    fillErrors = 0;
+    frameIters = 0;
+    frameSaved = 0;
+    memset(workerStats, 0, nbThreads * sizeof(worker_stats_t));
+    memset(tileIters, 0, nbTiles * sizeof(long));
+    memset(tileCached, 0, nbTiles);
+    frameHits = 0;
+    frameMisses = 0;
+    frameDone = false;
+    frameMode = mode;
+    cacheStartFrame();
+    symStartFrame();
+    aaStartFrame();
+    presentStartFrame();
+    if (mode != FRAME_AA) {
+        updateReference(); // la vue n'a pas changé
+    }
+    orderTiles();
+    pthread_mutex_lock(&mutex);
+    frameStart = now();
+    snapshotStats(false);
+    __atomic_add_fetch(&workEpoch, 1, __ATOMIC_SEQ_CST);
+    publishPass(mode == FRAME_FULL ? 0 : mode == FRAME_AA ? AA_PASS : PASSES - 1);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool workAvailable() {
+    unsigned long long t = __atomic_load_n(&ticket, __ATOMIC_SEQ_CST);
+    return (unsigned) (t >> 32) == __atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST)
+        && (int) (t & 0xffffffff) < nbTiles;
+}
+
+void* child(void *arg) {
+    long id = (long) arg;
+    myStats = &workerStats[id];
+    while (1) {
+      double t0 = now();
+      pthread_mutex_lock(&mutex);
+      while ((!workAvailable() || id >= activeThreads) && keepGoing) {
+        pthread_cond_wait(&cond, &mutex);
+      }
+      // sous mutex : startFrame ne remet pas la case à zéro entre-temps
+      myStats->wait += now() - std::max(t0, frameStart); // l'attente entre deux images ne compte pas
+      pthread_mutex_unlock(&mutex);
+
+      if (!keepGoing) {
+        return NULL;
+      }
+
+      // Pas de verrou par tuile : chaque thread réserve la suivante avec un
+      // simple incrément atomique.
+      while (1) {
+        __atomic_add_fetch(&inFlight, 1, __ATOMIC_SEQ_CST);
+        unsigned long long t = __atomic_fetch_add(&ticket, 1, __ATOMIC_SEQ_CST);
+        unsigned epoch = t >> 32;
+        int idx = t & 0xffffffff;
+        if (epoch != __atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST) || idx >= nbTiles) {
+          __atomic_sub_fetch(&inFlight, 1, __ATOMIC_SEQ_CST);
+          break;
+        }
+        int tile = tileOrder[idx];
+        long before = myStats->iters;
+        double t1 = now();
+        myStats->cost = -1;
+        bool done = renderTile(tile, curPass, epoch);
+        double t2 = now();
+        myStats->tiles++;
+        myStats->busy += t2 - t1;
+        myStats->lastEnd = t2;
+        tile_record_t *r = &tileRecords[id * recordStride + myStats->records++];
+        r->tile = tile;
+        r->iters = myStats->iters - before;
+        r->cost = myStats->cost;
+        if (done && __atomic_add_fetch(&tilesDone, 1, __ATOMIC_SEQ_CST) == nbTiles) {
+          passFinished(epoch);
+        }
+        __atomic_sub_fetch(&inFlight, 1, __ATOMIC_SEQ_CST);
+      }
+    }
+
+    return NULL;
+}
+
+/* STATISTIQUES ***************************************************************/
+
+// 'i' affiche les compteurs des threads et la carte des itérations par
+// tuile par-dessus l'image, 'j' ajoute une ligne JSON par image terminée
+// dans STATS_FILE.
+
+#define STATS_FILE "julia_stats.jsonl"
+
+bool showStats = false;
+FILE *statsFile = NULL;
+const char* frameModeNames[] = {"full", "pan", "resume", "aa"};
+
+// Temps passé sans travail à la fin de l'image par le thread w
+double idleAtEnd(const worker_stats_t *w, double start, double end) {
+    return end - (w->tiles > 0 ? w->lastEnd : start);
+}
+
+void drawStats(cv::Mat& img) {
+    char line[200];
+    const stats_snapshot_t *s = &shownStats;
+    pthread_mutex_lock(&mutex);
+    worker_stats_t *workers = shownStats.workers;
+    long *iters = shownStats.tileIters;
+    shownStats = passStats;
+    shownStats.workers = workers;
+    shownStats.tileIters = iters;
+    memcpy(workers, passStats.workers, passStats.threads * sizeof(worker_stats_t));
+    memcpy(iters, passStats.tileIters, nbTiles * sizeof(long));
+    pthread_mutex_unlock(&mutex);
+    double end = s->done ? s->end : now();
+    int h = 16 * (s->threads + (cacheTable ? 4 : 3)) + 8;
+    cv::rectangle(img, cv::Point(0, 0), cv::Point(430, h), cv::Scalar(0, 0, 0), cv::FILLED);
+    snprintf(line, sizeof(line), "%s frame: %.1f ms, %.1f Mit, %.1f Mit saved", frameModeNames[s->mode],
+             (end - s->start) * 1e3, s->iters * 1e-6, s->saved * 1e-6);
+    cv::putText(img, line, cv::Point(4, 14), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
+    cv::putText(img, "thread  tiles     Mit   busy ms   wait ms   idle ms", cv::Point(4, 30),
+                cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
+    for (int t = 0; t < s->threads; t++) {
+        const worker_stats_t *w = &s->workers[t];
+        snprintf(line, sizeof(line), "%6d %6ld %7.1f %9.1f %9.1f %9.1f", t, w->tiles, w->iters * 1e-6,
+                 w->busy * 1e3, w->wait * 1e3, idleAtEnd(w, s->start, end) * 1e3);
+        cv::putText(img, line, cv::Point(4, 46 + 16 * t), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
+    }
+    if (cacheTable) {
+        double ramMb, diskMb;
+        cacheUsage(&ramMb, &diskMb);
+        snprintf(line, sizeof(line), "cache: %ld/%ld tiles, total %ld/%ld, %.0f + %.0f MB", s->hits,
+                 s->hits + s->misses, s->totalHits, s->totalHits + s->totalMisses, ramMb, diskMb);
+        cv::putText(img, line, cv::Point(4, 46 + 16 * s->threads), cv::FONT_HERSHEY_PLAIN, 1.0,
+                    cv::Scalar(255, 255, 255));
+    }
+    // les histogrammes ne sont remplis que par le thread principal
+    snprintf(line, sizeof(line), "latency p50 %.1f p95 %.1f ms, frame p50 %.1f p95 %.1f ms",
+             histQuantile(&latencyHist, 0.5), histQuantile(&latencyHist, 0.95),
+             histQuantile(&frameHist, 0.5), histQuantile(&frameHist, 0.95));
+    cv::putText(img, line, cv::Point(4, 46 + 16 * (s->threads + (cacheTable ? 1 : 0))), cv::FONT_HERSHEY_PLAIN,
+                1.0, cv::Scalar(255, 255, 255));
+
+    // carte des itérations par tuile (du noir au rouge)
+    long top = 1;
+    for (int t = 0; t < nbTiles; t++) {
+        top = std::max(top, s->tileIters[t]);
+    }
+    int cell = std::max(1, 256 / std::max(tilesX, tilesY));
+    int x0 = IMG_W - cell * tilesX;
+    for (int t = 0; t < nbTiles; t++) {
+        int x = x0 + (t % tilesX) * cell;
+        int y = (t / tilesX) * cell;
+        int v = s->tileIters[t] * 255 / top;
+        cv::rectangle(img, cv::Point(x, y), cv::Point(x + cell - 1, y + cell - 1), cv::Scalar(0, v / 2, v), cv::FILLED);
+    }
+}
+
+// Une ligne JSON pour l'image qui vient de se terminer
+void dumpStats(FILE *f) {
+    fprintf(f, "{\"frame\": %d, \"mode\": \"%s\", \"width\": %d, \"height\": %d, \"maxIter\": %d, "
+            "\"fractal\": \"%s\", \"precision\": \"%s\", \"simd\": \"%s\", \"tileSize\": %d, \"wallMs\": %.3f, "
+            "\"iterations\": %ld, \"saved\": %ld, \"cacheHits\": %ld, \"cacheMisses\": %ld, "
+            "\"aaPixels\": %ld, \"aaSamples\": %ld, \"latencyMs\": %.3f, \"presentMs\": %.3f, \"workers\": [",
+            frameCount, frameModeNames[frameMode], IMG_W, IMG_H, maxIter, fractalNames[fractal],
+            precisionNames[currentPrecision()], simdNames[simdLevel], tileSize, (frameEnd - frameStart) * 1e3, frameIters, frameSaved,
+            frameHits, frameMisses, aaPixels, aaSamples, lastLatency, lastPresent);
+    for (int t = 0; t < activeThreads; t++) {
+        const worker_stats_t *w = &workerStats[t];
+        fprintf(f, "%s{\"tiles\": %ld, \"iterations\": %ld, \"saved\": %ld, \"busyMs\": %.3f, "
+                "\"waitMs\": %.3f, \"idleEndMs\": %.3f}", t ? ", " : "", w->tiles, w->iters, w->saved,
+                w->busy * 1e3, w->wait * 1e3, idleAtEnd(w, frameStart, frameEnd) * 1e3);
+    }
+    fprintf(f, "], \"tilesX\": %d, \"tilesY\": %d, \"tileIterations\": [", tilesX, tilesY);
+    for (int y = 0; y < tilesY; y++) {
+        fprintf(f, "%s[", y ? ", " : "");
+        for (int x = 0; x < tilesX; x++) {
+            fprintf(f, "%s%ld", x ? ", " : "", tileIters[y * tilesX + x]);
+        }
+        fprintf(f, "]");
+    }
+    fprintf(f, "]}\n");
+    fflush(f);
+}
+
+/* BENCHMARK *****************************************************************/
+
+// Mesure des images complètes dans un seul processus : le pool de threads,
+// l'image et les tampons sont créés une fois, seul le calcul est chronométré.
+
+// Attend la fin de l'image lancée par startFrame
+void waitFrame() {
+    pthread_mutex_lock(&mutex);
+    while (!frameDone) {
+        pthread_cond_wait(&doneCond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void parseInts(const char *arg, std::vector<int>& out) {
+    out.clear();
+    for (const char *p = arg; *p; p++) {
+        out.push_back(atoi(p));
+        while (*p && *p != ',') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+    }
+}
+
+// Liste de noms séparés par des virgules -> indices dans names
+bool parseNames(const char *arg, const char * const *names, int nbNames, std::vector<int>& out) {
+    out.clear();
+    while (*arg) {
+        const char *end = strchr(arg, ',');
+        size_t len = end ? (size_t) (end - arg) : strlen(arg);
+        int k;
+        for (k = 0; k < nbNames; k++) {
+            if (strlen(names[k]) == len && strncasecmp(names[k], arg, len) == 0) {
+                break;
+            }
+        }
+        if (k == nbNames) {
+            fprintf(stderr, "Unknown value: %.*s\n", (int) len, arg);
+            return false;
+        }
+        out.push_back(k);
+        arg += len + (end ? 1 : 0);
+    }
+    return true;
+}
+
+// c=min:max:step (grille carrée, comme benchmark.py) ou c=re/im,re/im...
+void parseC(const char *arg, std::vector<complex>& out) {
+    out.clear();
+    double lo, hi, step;
+    if (sscanf(arg, "%lf:%lf:%lf", &lo, &hi, &step) == 3 && step > 0) {
+        int n = (int) floor((hi - lo) / step + 0.5);
+        for (int r = 0; r <= n; r++) {
+            for (int i = 0; i <= n; i++) {
+                out.push_back(new_complex(lo + r * step, lo + i * step));
+            }
+        }
+        return;
+    }
+    for (const char *p = arg; *p; ) {
+        double re = 0.0;
+        double im = 0.0;
+        sscanf(p, "%lf/%lf", &re, &im);
+        out.push_back(new_complex(re, im));
+        p = strchr(p, ',');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+}
+
+int bench(int argc, char *argv[]) {
+    std::vector<int> threads;
+    std::vector<int> tiles(1, TILE_SIZE);
+    std::vector<int> iters(1, maxIter);
+    std::vector<int> precisions(1, PREC_AUTO);
+    std::vector<int> simds(1, simdLevel);
+    std::vector<complex> cs(1, new_complex(-1.41702285618, 0.0));
+    int warmup = 1;
+    int reps = 5;
+    for (int t = 1; t <= sysconf(_SC_NPROCESSORS_ONLN); t *= 2) {
+        threads.push_back(t);
+    }
+
+    for (int a = 0; a < argc; a++) {
+        const char *eq = strchr(argv[a], '=');
+        if (!eq) {
+            fprintf(stderr, "Bad argument: %s\n", argv[a]);
+            return 1;
+        }
+        std::string key(argv[a], eq - argv[a]);
+        const char *val = eq + 1;
+        bool ok = true;
+        if (key == "threads") {
+            parseInts(val, threads);
+        }
+        else if (key == "tiles") {
+            parseInts(val, tiles);
+        }
+        else if (key == "maxiter") {
+            parseInts(val, iters);
+        }
+        else if (key == "c") {
+            parseC(val, cs);
+        }
+        else if (key == "precision") {
+            ok = parseNames(val, precisionNames, PRECISIONS, precisions);
+        }
+        else if (key == "simd") {
+            ok = parseNames(val, simdNames, SIMD_LEVELS, simds);
+        }
+        else if (key == "warmup") {
+            warmup = atoi(val);
+        }
+        else if (key == "reps") {
+            reps = std::max(1, atoi(val));
+        }
+        else if (key == "symmetry") {
+            symmetry = atoi(val) != 0;
+        }
+        else if (key == "fractal") {
+            std::vector<int> names;
+            ok = parseNames(val, fractalNames, FRACTALS, names);
+            if (ok) {
+                fractal = (fractal_t) names[0];
+            }
+        }
+        else if (key == "aa") {
+            setAntialias(atoi(val));
+        }
+        else if (key == "aathreshold") {
+            aaThreshold = atoi(val);
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", key.c_str());
+            ok = false;
+        }
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    simd_level_t detected = simdLevel;
+    nbThreads = 1;
+    for (size_t k = 0; k < threads.size(); k++) {
+        threads[k] = std::max(1, threads[k]);
+        nbThreads = std::max(nbThreads, threads[k]);
+    }
+    for (size_t k = 0; k < simds.size(); k++) {
+        if (simds[k] > detected) {
+            fprintf(stderr, "%s is not supported by this processor\n", simdNames[simds[k]]);
+            return 1;
+        }
+    }
+    verbose = false;
+    initColorLuts();
+
+    if (!initStats()) {
+        fprintf(stderr, "Not enough memory for %d threads\n", nbThreads);
+        return 1;
+    }
+    pthread_t tid[nbThreads];
+    for (int j = 0; j < nbThreads; j++) {
+        pthread_create(&tid[j], NULL, child, (void*) (long) j);
+    }
+
+    std::vector<double> times(reps);
+    for (size_t it = 0; it < iters.size(); it++)
+    for (size_t ts = 0; ts < tiles.size(); ts++)
+    for (size_t th = 0; th < threads.size(); th++)
+    for (size_t pr = 0; pr < precisions.size(); pr++)
+    for (size_t sl = 0; sl < simds.size(); sl++)
+    for (size_t k = 0; k < cs.size(); k++) {
+        // frameDone n'attend pas les threads encore dans leur dernier
+        // fetch_add : les laisser sortir avant de changer les paramètres
+        cancelFrame();
+        maxIter = iters[it];
+        int size = std::max(1, tiles[ts] / 8) * 8;
+        if (size != tileSize || tileOrder == NULL) {
+            tileSize = size;
+            initTiles(); // garde l'ordre des coûts d'un point à l'autre
+        }
+        activeThreads = threads[th];
+        forcedPrecision = (precision_t) precisions[pr];
+        simdLevel = (simd_level_t) simds[sl];
+        c = cs[k];
+
+        for (int r = 0; r < warmup + reps; r++) {
+            double t0 = now();
+            startFrame(FRAME_FULL);
+            waitFrame();
+            if (r >= warmup) {
+                times[r - warmup] = now() - t0;
+            }
+        }
+        std::sort(times.begin(), times.end());
+        double median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+        double p95 = times[std::min(reps - 1, (int) ceil(0.95 * reps) - 1)];
+        printf("%d,%d,%f,%f,%f,%f,%d,%s,%s,%.2f,%.3f\n", activeThreads, tileSize,
+               (double) c.real, (double) c.imag, median, p95, maxIter,
+               precisionNames[currentPrecision()], simdNames[simdLevel],
+               IMG_W * IMG_H / median * 1e-6, frameIters / median * 1e-9);
+        fflush(stdout);
+    }
+
+    keepGoing = false;
+    pthread_mutex_lock(&mutex);
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    for (int j = 0; j < nbThreads; j++) {
+        pthread_join(tid[j], NULL);
+    }
+    free_ref_orbit(refOrbit);
+    free_ref_orbit(critOrbit);
+    return 0;
+}
+
+/* RENDU HORS FENETRE ********************************************************/
+
+// Vue calculée sans fenêtre (affiche, animation, rendu distribué) : image
+// w x h centrée sur center, pixels de taille step.
+typedef struct {
+    int w;
+    int h;
+    complex c;
+    long double centerRe;
+    long double centerIm;
+    long double step;
+    int maxIter;
+    precision_t precision;
+    bool period;
+    fractal_t fractal;
+    ref_orbit_t *ref;  // orbites de perturbation (PREC_PERTURBATION)
+    ref_orbit_t *crit;
+} view_t;
+
+// Même cadrage que la fenêtre : le plus petit côté couvre [-zoom, zoom]
+long double viewStep(int w, int h, long double z) {
+    return (limitRight - limitLeft) * z / std::min(w, h);
+}
+
+void setupView(view_t *v, int w, int h, complex cc, long double re, long double im, long double step, int iter) {
+    v->w = w;
+    v->h = h;
+    v->c = cc;
+    v->centerRe = re;
+    v->centerIm = im;
+    v->step = step;
+    v->maxIter = iter;
+    v->precision = precisionFor(step);
+    v->period = periodCheck;
+    v->fractal = fractal;
+    v->ref = NULL;
+    v->crit = NULL;
+}
+
+// Orbites de référence, à construire avant viewRow en perturbation
+void viewOrbits(view_t *v) {
+    if (v->precision == PREC_PERTURBATION) {
+        dd_t cr = new_dd(v->c.real);
+        dd_t ci = new_dd(v->c.imag);
+        v->ref = new_ref_orbit(new_dd(v->centerRe), new_dd(v->centerIm), cr, ci, v->maxIter);
+        v->crit = new_ref_orbit(new_dd(0.0), new_dd(0.0), cr, ci, v->maxIter);
+    }
+}
+
+void freeView(view_t *v) {
+    free_ref_orbit(v->ref);
+    free_ref_orbit(v->crit);
+    v->ref = NULL;
+    v->crit = NULL;
+}
+
+// Calcule la ligne y de la vue
+void viewRow(const view_t *v, int y, int *its) {
+    long double re0 = v->centerRe - (v->w / 2) * v->step;
+    long double im0 = v->centerIm + (y - v->h / 2) * v->step;
+    switch (v->precision) {
+      case PREC_FLOAT:
+        escapeSpanFloat(re0, im0, v->step, 0.0, v->w, v->c.real, v->c.imag, v->maxIter, its, v->period, NULL,
+                        v->fractal);
+        break;
+      case PREC_DOUBLE:
+        escapeSpanDouble(re0, im0, v->step, 0.0, v->w, v->c.real, v->c.imag, v->maxIter, its, v->period, NULL,
+                         v->fractal);
+        break;
+      case PREC_PERTURBATION:
+        escapeSpanPerturb(v->ref, v->crit, (double) (-(v->w / 2) * v->step),
+                          (double) ((y - v->h / 2) * v->step), v->step, 0.0, v->w,
+                          v->maxIter, its, v->period, NULL);
+        break;
+      case PREC_LONG_DOUBLE:
+      default:
+        escapeSpanLongDouble(re0, im0, v->step, 0.0, v->w, v->c.real, v->c.imag, v->maxIter, its, v->period, NULL,
+                             v->fractal);
+        break;
+    }
+}
+
+// Table RGB (3 octets par nombre d'itérations) pour le mode de couleur courant
+unsigned char* newRgbLut(int iter) {
+    std::vector<cv::Vec3b> bgr(iter + 1);
+    buildIterLut(bgr.data(), iter);
+    unsigned char *lut = (unsigned char*) malloc(3 * (iter + 1));
+    for (int it = 0; it <= iter; it++) {
+        lut[3 * it] = bgr[it][2];
+        lut[3 * it + 1] = bgr[it][1];
+        lut[3 * it + 2] = bgr[it][0];
+    }
+    return lut;
+}
+
+// Écriture d'une image ligne par ligne : PNG si le nom finit par .png,
+// PPM binaire sinon
+typedef struct {
+    FILE *f;
+    int w;
+    png_structp png;
+    png_infop info;
+} image_writer_t;
+
+bool openImage(image_writer_t *w, const char *name, int width, int height) {
+    w->png = NULL;
+    w->w = width;
+    w->f = fopen(name, "wb");
+    if (!w->f) {
+        return false;
+    }
+    size_t len = strlen(name);
+    if (len < 4 || strcasecmp(name + len - 4, ".png") != 0) {
+        fprintf(w->f, "P6\n%d %d\n255\n", width, height);
+        return true;
+    }
+    // en cas d'échec, le fichier est refermé : l'appelant n'appelle pas closeImage
+    w->info = NULL;
+    w->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (w->png) {
+        w->info = png_create_info_struct(w->png);
+    }
+    if (!w->png || !w->info) {
+        png_destroy_write_struct(&w->png, &w->info);
+        fclose(w->f);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(w->png))) {
+        png_destroy_write_struct(&w->png, &w->info);
+        fclose(w->f);
+        return false;
+    }
+    png_init_io(w->png, w->f);
+    png_set_IHDR(w->png, w->info, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(w->png, w->info);
+    return true;
+}
+
+// Écrit n lignes RGB consécutives
+bool writeImageRows(image_writer_t *w, unsigned char *rows, int n) {
+    if (!w->png) {
+        return fwrite(rows, (size_t) w->w * 3, n, w->f) == (size_t) n;
+    }
+    if (setjmp(png_jmpbuf(w->png))) {
+        return false;
+    }
+    for (int k = 0; k < n; k++) {
+        png_write_row(w->png, rows + (size_t) k * w->w * 3);
+    }
+    return true;
+}
+
+bool closeImage(image_writer_t *w) {
+    if (w->png) {
+        if (setjmp(png_jmpbuf(w->png))) {
+            png_destroy_write_struct(&w->png, &w->info);
+            fclose(w->f);
+            return false;
+        }
+        png_write_end(w->png, NULL);
+        png_destroy_write_struct(&w->png, &w->info);
+    }
+    return fclose(w->f) == 0;
+}
+
+/* POSTER ********************************************************************/
+
+// Rendu d'une image de taille quelconque : les threads calculent des bandes
+// horizontales et le thread principal les écrit dans l'ordre pendant que les
+// suivantes sont calculées. Seules quelques bandes sont en mémoire, quelle
+// que soit la taille de l'image.
+
+view_t posterView;
+int bandH = 64;
+int nbBands = 0;
+int bandSlots = 0;              // bandes en mémoire (calculées ou à écrire)
+unsigned char *bandBuf = NULL;  // bandSlots bandes RGB de posterView.w x bandH
+int *bandReady = NULL;          // indice de la bande présente dans chaque case
+int nextBand = 0;               // prochaine bande à calculer
+int bandsWritten = 0;
+unsigned char *rgbLut = NULL;
+pthread_mutex_t bandMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t bandFree = PTHREAD_COND_INITIALIZER;
+pthread_cond_t bandDone = PTHREAD_COND_INITIALIZER;
+
+void* posterChild(void *arg) {
+    const view_t *v = &posterView;
+    int *its = (int*) malloc(v->w * sizeof(int));
+    while (1) {
+        pthread_mutex_lock(&bandMutex);
+        while (nextBand < nbBands && nextBand >= bandsWritten + bandSlots) {
+            pthread_cond_wait(&bandFree, &bandMutex);
+        }
+        int b = nextBand++;
+        pthread_mutex_unlock(&bandMutex);
+        if (b >= nbBands) {
+            break;
+        }
+
+        unsigned char *band = bandBuf + (size_t) (b % bandSlots) * bandH * v->w * 3;
+        for (int y = b * bandH; y < std::min(v->h, (b + 1) * bandH); y++) {
+            viewRow(v, y, its);
+            unsigned char *row = band + (size_t) (y - b * bandH) * v->w * 3;
+            for (int x = 0; x < v->w; x++) {
+                memcpy(row + 3 * x, rgbLut + 3 * std::min(its[x], v->maxIter), 3);
+            }
+        }
+
+        pthread_mutex_lock(&bandMutex);
+        bandReady[b % bandSlots] = b;
+        pthread_cond_broadcast(&bandDone);
+        pthread_mutex_unlock(&bandMutex);
+    }
+    free(its);
+    return NULL;
+}
+
+// Options communes à --poster et --animate. Retourne false si l'option
+// est inconnue.
+bool parseViewOption(const std::string& key, const char *val, int *threads) {
+    std::vector<int> names;
+    if (key == "threads") {
+        *threads = std::max(1, atoi(val));
+    }
+    else if (key == "color" && parseNames(val, colorNames, COLOR_MODES, names)) {
+        colorMode = (color_mode_t) names[0];
+    }
+    else if (key == "precision" && parseNames(val, precisionNames, PRECISIONS, names)) {
+        forcedPrecision = (precision_t) names[0];
+    }
+    else if (key == "period") {
+        periodCheck = atoi(val) != 0;
+    }
+    else if (key == "fractal" && parseNames(val, fractalNames, FRACTALS, names)) {
+        fractal = (fractal_t) names[0];
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// julia_bw2 --poster WIDTH HEIGHT FILE [option=value...]
+int poster(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: --poster WIDTH HEIGHT FILE [options]\n");
+        return 1;
+    }
+    int width = atoi(argv[0]);
+    int height = atoi(argv[1]);
+    const char *name = argv[2];
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    complex center = new_complex(0.0, 0.0);
+    std::vector<complex> cs;
+    for (int a = 3; a < argc; a++) {
+        const char *eq = strchr(argv[a], '=');
+        std::string key(argv[a], eq ? eq - argv[a] : strlen(argv[a]));
+        const char *val = eq ? eq + 1 : "";
+        if (key == "c") {
+            parseC(val, cs);
+            if (!cs.empty()) {
+                c = cs[0];
+            }
+        }
+        else if (key == "center") {
+            parseC(val, cs);
+            if (!cs.empty()) {
+                center = cs[0];
+            }
+        }
+        else if (key == "zoom") {
+            zoom = strtold(val, NULL);
+        }
+        else if (key == "maxiter") {
+            maxIter = std::max(1, atoi(val));
+        }
+        else if (key == "band") {
+            bandH = std::max(1, atoi(val));
+        }
+        else if (!parseViewOption(key, val, &threads)) {
+            fprintf(stderr, "Bad option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Bad size: %s x %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    view_t *v = &posterView;
+    setupView(v, width, height, c, center.real, center.imag, viewStep(width, height, zoom), maxIter);
+    viewOrbits(v);
+    initColorLuts();
+    rgbLut = newRgbLut(maxIter);
+
+    nbBands = (height + bandH - 1) / bandH;
+    bandSlots = std::min(nbBands, 2 * threads + 1);
+    bandBuf = (unsigned char*) malloc((size_t) bandSlots * bandH * width * 3);
+    bandReady = (int*) malloc(bandSlots * sizeof(int));
+    if (!bandBuf || !bandReady) {
+        fprintf(stderr, "Not enough memory for %d bands of %d x %d\n", bandSlots, width, bandH);
+        return 1;
+    }
+    for (int k = 0; k < bandSlots; k++) {
+        bandReady[k] = -1;
+    }
+    image_writer_t w;
+    if (!openImage(&w, name, width, height)) {
+        fprintf(stderr, "Cannot write %s\n", name);
+        return 1;
+    }
+    fprintf(stderr, "Poster %d x %d, %s precision, %d bands of %d rows, %d in memory\n",
+            width, height, precisionNames[v->precision], nbBands, bandH, bandSlots);
+
+    double t0 = now();
+    pthread_t tid[threads];
+    for (int j = 0; j < threads; j++) {
+        pthread_create(&tid[j], NULL, posterChild, NULL);
+    }
+    bool ok = true;
+    for (int b = 0; b < nbBands; b++) {
+        pthread_mutex_lock(&bandMutex);
+        while (bandReady[b % bandSlots] != b) {
+            pthread_cond_wait(&bandDone, &bandMutex);
+        }
+        pthread_mutex_unlock(&bandMutex);
+
+        int rows = std::min(height, (b + 1) * bandH) - b * bandH;
+        ok = ok && writeImageRows(&w, bandBuf + (size_t) (b % bandSlots) * bandH * width * 3, rows);
+
+        pthread_mutex_lock(&bandMutex);
+        bandsWritten = b + 1;
+        pthread_cond_broadcast(&bandFree);
+        pthread_mutex_unlock(&bandMutex);
+        fprintf(stderr, "\r%d / %d bands", b + 1, nbBands);
+    }
+    for (int j = 0; j < threads; j++) {
+        pthread_join(tid[j], NULL);
+    }
+    ok = closeImage(&w) && ok;
+    fprintf(stderr, "\n%s %s in %.1f s\n", ok ? "Wrote" : "Failed to write", name, now() - t0);
+
+    free(bandBuf);
+    free(bandReady);
+    free(rgbLut);
+    freeView(v);
+    return ok ? 0 : 1;
+}
+
+/* ANIMATION *****************************************************************/
+
+// Rendu d'une suite d'images le long d'un chemin d'images clés. Trois
+// étages tournent en parallèle sur plusieurs images à la fois :
+// - les threads de calcul prennent des bandes de n'importe quelle image en
+//   cours (celles de l'image la plus ancienne d'abord) ;
+// - un thread colorie chaque image dès que toutes ses bandes sont calculées ;
+// - le thread principal encode et écrit les images dans l'ordre, puis
+//   prépare l'image suivante dans la case libérée.
+
+typedef struct {
+    complex c;
+    long double centerRe;
+    long double centerIm;
+    long double zoom;
+    int maxIter;
+} keyframe_t;
+
+typedef enum {
+  ANIM_FREE = 0,
+  ANIM_COMPUTING,
+  ANIM_COMPUTED,
+  ANIM_COLORED
+} anim_state_t;
+
+typedef struct {
+    int frame;
+    anim_state_t state;
+    int bandsDone;
+    view_t view;
+    int *its;            // nombre d'itérations de chaque pixel
+    unsigned char *rgb;  // image coloriée
+} anim_slot_t;
+
+int animW = IMG_W;
+int animH = IMG_H;
+int animFrames = 0;
+int animSlots = 3;     // images en cours en même temps
+int animBandH = 16;
+int animBands = 0;     // bandes par image
+long nextWork = 0;     // prochaine bande (frame * animBands + bande)
+anim_slot_t *slots = NULL;
+std::vector<keyframe_t> keyframes;
+pthread_mutex_t animMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t animCond = PTHREAD_COND_INITIALIZER;
+
+// Lit un fichier d'images clés : une par ligne,
+// "c_re c_im centre_re centre_im zoom maxIter" ('#' : commentaire)
+bool readPath(const char *name) {
+    FILE *f = fopen(name, "r");
+    if (!f) {
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        keyframe_t k;
+        double cr, ci;
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%lf %lf %Lf %Lf %Lf %d", &cr, &ci, &k.centerRe, &k.centerIm, &k.zoom, &k.maxIter) == 6) {
+            k.c = new_complex(cr, ci);
+            keyframes.push_back(k);
+        }
+    }
+    fclose(f);
+    return !keyframes.empty();
+}
+
+// Paramètres de l'image f : interpolation linéaire entre les images clés,
+// géométrique pour le zoom
+keyframe_t pathAt(int f) {
+    int m = keyframes.size();
+    long double s = animFrames > 1 ? (long double) f * (m - 1) / (animFrames - 1) : 0.0;
+    int i = std::min((int) s, m - 1);
+    long double u = s - i;
+    const keyframe_t& a = keyframes[i];
+    const keyframe_t& b = keyframes[std::min(i + 1, m - 1)];
+    keyframe_t k;
+    k.c = new_complex(a.c.real + (b.c.real - a.c.real) * u, a.c.imag + (b.c.imag - a.c.imag) * u);
+    k.centerRe = a.centerRe + (b.centerRe - a.centerRe) * u;
+    k.centerIm = a.centerIm + (b.centerIm - a.centerIm) * u;
+    k.zoom = expl(logl(a.zoom) + (logl(b.zoom) - logl(a.zoom)) * u);
+    k.maxIter = (int) (a.maxIter + (b.maxIter - a.maxIter) * u + 0.5);
+    return k;
+}
+
+// Prépare l'image f dans sa case (thread principal, case libre)
+void setupFrame(int f) {
+    anim_slot_t *s = &slots[f % animSlots];
+    keyframe_t k = pathAt(f);
+    freeView(&s->view);
+    setupView(&s->view, animW, animH, k.c, k.centerRe, k.centerIm, viewStep(animW, animH, k.zoom), k.maxIter);
+    viewOrbits(&s->view);
+    pthread_mutex_lock(&animMutex);
+    s->frame = f;
+    s->bandsDone = 0;
+    s->state = ANIM_COMPUTING;
+    pthread_cond_broadcast(&animCond);
+    pthread_mutex_unlock(&animMutex);
+}
+
+// La bande w est prête à être calculée si son image est en place
+bool workReady(long w) {
+    int f = w / animBands;
+    return f < animFrames && slots[f % animSlots].frame == f && slots[f % animSlots].state == ANIM_COMPUTING;
+}
+
+void* animChild(void *arg) {
+    while (1) {
+        pthread_mutex_lock(&animMutex);
+        while (nextWork < (long) animFrames * animBands && !workReady(nextWork)) {
+            pthread_cond_wait(&animCond, &animMutex);
+        }
+        long w = nextWork++;
+        pthread_mutex_unlock(&animMutex);
+        if (w >= (long) animFrames * animBands) {
+            break;
+        }
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
-int nextPart = 0;
-cv::Mat newImg(IMG_H, IMG_W, CV_8UC3, cv::Vec3b(0,0,0));
-int partSize = 0;
-bool keepGoing = true;
-int offsetColor = 0;
-color_mode_t colorMode = HUE;
+        anim_slot_t *s = &slots[(w / animBands) % animSlots];
+        int b = w % animBands;
+        for (int y = b * animBandH; y < std::min(animH, (b + 1) * animBandH); y++) {
+            viewRow(&s->view, y, s->its + (size_t) y * animW);
+        }
 
-long double offsetLeft = 0.0;
-long double offsetTop = 0.0;
-long double limitLeft = -1.0;
-long double limitRight = 1.0;
-long double limitTop = -1.0;
-long double limitBottom = 1.0;
+        pthread_mutex_lock(&animMutex);
+        if (++s->bandsDone == animBands) {
+            s->state = ANIM_COMPUTED;
+            pthread_cond_broadcast(&animCond);
+        }
+        pthread_mutex_unlock(&animMutex);
+    }
+    return NULL;
+}
 
-int maxIter = 300;
-long double zoom = 1.0;
+// Étage de coloriage : les images dans l'ordre, dès qu'elles sont calculées
+void* animColorer(void *arg) {
+    int iter = -1;
+    unsigned char *lut = NULL;
+    for (int f = 0; f < animFrames; f++) {
+        anim_slot_t *s = &slots[f % animSlots];
+        pthread_mutex_lock(&animMutex);
+        while (s->frame != f || s->state != ANIM_COMPUTED) {
+            pthread_cond_wait(&animCond, &animMutex);
+        }
+        pthread_mutex_unlock(&animMutex);
 
-/* MANIPULER LES NOMBRES COMPLEXES ********************************************/
+        if (s->view.maxIter != iter) {
+            free(lut);
+            iter = s->view.maxIter;
+            lut = newRgbLut(iter);
+        }
+        for (size_t p = 0; p < (size_t) animW * animH; p++) {
+            memcpy(s->rgb + 3 * p, lut + 3 * std::min(s->its[p], iter), 3);
+        }
+
+        pthread_mutex_lock(&animMutex);
+        s->state = ANIM_COLORED;
+        pthread_cond_broadcast(&animCond);
+        pthread_mutex_unlock(&animMutex);
+    }
+    free(lut);
+    return NULL;
+}
+
+// Encodage d'une image RGB : y4m (YUV 4:4:4), BGR brut ou fichier numéroté
+typedef enum {
+  OUT_Y4M = 0,
+  OUT_BGR,
+  OUT_FILES
+} anim_output_t;
+
+const char* outputNames[] = {"y4m", "bgr", "files"};
+
+bool writeFrame(anim_output_t out, const char *pattern, int f, const unsigned char *rgb, unsigned char *tmp) {
+    size_t n = (size_t) animW * animH;
+    if (out == OUT_FILES) {
+        char name[1024];
+        snprintf(name, sizeof(name), pattern, f);
+        image_writer_t w;
+        if (!openImage(&w, name, animW, animH)) {
+            return false;
+        }
+        bool ok = writeImageRows(&w, (unsigned char*) rgb, animH);
+        return closeImage(&w) && ok;
+    }
+    if (out == OUT_BGR) {
+        for (size_t p = 0; p < n; p++) {
+            tmp[3 * p] = rgb[3 * p + 2];
+            tmp[3 * p + 1] = rgb[3 * p + 1];
+            tmp[3 * p + 2] = rgb[3 * p];
+        }
+        return fwrite(tmp, 3, n, stdout) == n;
+    }
+    // BT.601, plage réduite
+    for (size_t p = 0; p < n; p++) {
+        int r = rgb[3 * p];
+        int g = rgb[3 * p + 1];
+        int b = rgb[3 * p + 2];
+        tmp[p] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        tmp[n + p] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        tmp[2 * n + p] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+    fputs("FRAME\n", stdout);
+    return fwrite(tmp, 3, n, stdout) == n;
+}
+
+// julia_bw2 --animate PATH FRAMES OUTPUT [option=value...]
+int animate(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: --animate PATH FRAMES OUTPUT [options]\n");
+        return 1;
+    }
+    if (!readPath(argv[0])) {
+        fprintf(stderr, "Cannot read keyframes from %s\n", argv[0]);
+        return 1;
+    }
+    animFrames = atoi(argv[1]);
+    const char *pattern = argv[2];
+    anim_output_t out = strcmp(pattern, "-") == 0 ? OUT_Y4M : OUT_FILES;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int fps = 25;
+    std::vector<int> names;
+    for (int a = 3; a < argc; a++) {
+        const char *eq = strchr(argv[a], '=');
+        std::string key(argv[a], eq ? eq - argv[a] : strlen(argv[a]));
+        const char *val = eq ? eq + 1 : "";
+        if (key == "width") {
+            animW = std::max(1, atoi(val));
+        }
+        else if (key == "height") {
+            animH = std::max(1, atoi(val));
+        }
+        else if (key == "fps") {
+            fps = std::max(1, atoi(val));
+        }
+        else if (key == "inflight") {
+            animSlots = std::max(1, atoi(val));
+        }
+        else if (key == "band") {
+            animBandH = std::max(1, atoi(val));
+        }
+        else if (key == "format" && out != OUT_FILES && parseNames(val, outputNames, OUT_FILES, names)) {
+            out = (anim_output_t) names[0];
+        }
+        else if (!parseViewOption(key, val, &threads)) {
+            fprintf(stderr, "Bad option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    if (animFrames <= 0) {
+        fprintf(stderr, "Bad number of frames: %s\n", argv[1]);
+        return 1;
+    }
+    if (out == OUT_FILES && !strchr(pattern, '%')) {
+        fprintf(stderr, "OUTPUT must be - (stdout) or a file pattern such as frame_%%05d.png\n");
+        return 1;
+    }
+
+    animBands = (animH + animBandH - 1) / animBandH;
+    animSlots = std::min(animSlots, animFrames);
+    slots = (anim_slot_t*) calloc(animSlots, sizeof(anim_slot_t));
+    for (int k = 0; k < animSlots; k++) {
+        slots[k].frame = -1;
+        slots[k].its = (int*) malloc((size_t) animW * animH * sizeof(int));
+        slots[k].rgb = (unsigned char*) malloc((size_t) animW * animH * 3);
+    }
+    unsigned char *tmp = (unsigned char*) malloc((size_t) animW * animH * 3);
+    initColorLuts();
+    if (out == OUT_Y4M) {
+        printf("YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", animW, animH, fps);
+    }
+
+    double t0 = now();
+    for (int f = 0; f < animSlots; f++) {
+        setupFrame(f);
+    }
+    pthread_t tid[threads];
+    pthread_t colorer;
+    for (int j = 0; j < threads; j++) {
+        pthread_create(&tid[j], NULL, animChild, NULL);
+    }
+    pthread_create(&colorer, NULL, animColorer, NULL);
+
+    bool ok = true;
+    for (int f = 0; f < animFrames; f++) {
+        anim_slot_t *s = &slots[f % animSlots];
+        pthread_mutex_lock(&animMutex);
+        while (s->frame != f || s->state != ANIM_COLORED) {
+            pthread_cond_wait(&animCond, &animMutex);
+        }
+        pthread_mutex_unlock(&animMutex);
+
+        ok = ok && writeFrame(out, pattern, f, s->rgb, tmp);
+        fprintf(stderr, "\rFrame %d / %d (%s)", f + 1, animFrames, precisionNames[s->view.precision]);
+        if (f + animSlots < animFrames) {
+            setupFrame(f + animSlots);
+        }
+    }
+    for (int j = 0; j < threads; j++) {
+        pthread_join(tid[j], NULL);
+    }
+    pthread_join(colorer, NULL);
+    fflush(stdout);
+    fprintf(stderr, "\n%s %d frames in %.1f s\n", ok ? "Wrote" : "Failed to write", animFrames, now() - t0);
+
+    for (int k = 0; k < animSlots; k++) {
+        freeView(&slots[k].view);
+        free(slots[k].its);
+        free(slots[k].rgb);
+    }
+    free(slots);
+    free(tmp);
+    return ok ? 0 : 1;
+}
+
+/* RENDU DISTRIBUE **********************************************************/
+
+// Le coordinateur découpe une image (ou une suite d'images) en bandes et les
+// envoie à des processus de calcul (--worker) par socket TCP ou Unix. Chaque
+// bande est un message autonome : un worker qui meurt ou ne répond plus est
+// déconnecté et ses bandes sont renvoyées à un autre. Les nombres d'itérations
+// reviennent au coordinateur, qui recolle, colorie et écrit les images.
+//
+// Protocole binaire, dans l'ordre des octets de la machine : coordinateur et
+// workers doivent partager la même architecture (vérifié par NET_MAGIC).
+
+#define NET_MAGIC 0x4a554c32  // "JUL2"
+
+typedef enum {
+  MSG_HELLO = 1,  // worker -> coordinateur : NET_MAGIC
+  MSG_TILE,       // coordinateur -> worker : tile_msg_t
+  MSG_RESULT,     // worker -> coordinateur : result_msg_t + rows * w entiers
+  MSG_BYE         // coordinateur -> worker : fin du travail
+} msg_type_t;
 
 typedef struct {
-    long double real;
-    long double imag;
-} complex;
-complex c; // GLOBALE
+    uint32_t type;
+    uint32_t tile;
+    int32_t w;
+    int32_t h;
+    int32_t y0;
+    int32_t rows;
+    int32_t maxIter;
+    int32_t precision;
+    int32_t period;
+    int32_t fractal;
+    double c[2];
+    double center[4];  // partie réelle (haute, basse), imaginaire (haute, basse)
+    double step[2];
+} tile_msg_t;
 
-complex new_complex(long double real, long double imag) {
-    complex c;
-    c.real = real;
-    c.imag = imag;
-    return c;
+typedef struct {
+    uint32_t type;
+    uint32_t tile;
+    uint32_t count;
+    uint32_t pad;
+} result_msg_t;
+
+// Un long double tient exactement dans deux doubles
+void splitLd(long double x, double *d) {
+    d[0] = (double) x;
+    d[1] = (double) (x - d[0]);
 }
 
-complex add_complex(complex a, complex b) {
-    a.real += b.real;
-    a.imag += b.imag;
-    return a;
+long double joinLd(const double *d) {
+    return (long double) d[0] + d[1];
 }
 
-complex mult_complex(complex a, complex b) {
-    complex m;
-    m.real = a.real * b.real - a.imag * b.imag;
-    m.imag = a.real * b.imag + a.imag * b.real;
-    return m;
+bool sendAll(int fd, const void *buf, size_t n) {
+    const char *p = (const char*) buf;
+    while (n > 0) {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k <= 0) {
+            return false;
+        }
+        p += k;
+        n -= k;
+    }
+    return true;
 }
 
-long double module_complex(complex c) {
-    return c.real * c.real + c.imag * c.imag;
+bool recvAll(int fd, void *buf, size_t n) {
+    char *p = (char*) buf;
+    while (n > 0) {
+        ssize_t k = recv(fd, p, n, 0);
+        if (k <= 0) {
+            return false;
+        }
+        p += k;
+        n -= k;
+    }
+    return true;
 }
 
-/* FRACTALE DE JULIA *****************************************************/
+// Adresse "unix:/chemin" ou "hôte:port". Retourne une socket connectée
+// (ou en écoute si server), -1 en cas d'échec.
+int openSocket(const char *addr, bool server) {
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, addr + 5, sizeof(sa.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server) {
+            unlink(sa.sun_path);
+        }
+        if (fd < 0 || (server ? bind(fd, (struct sockaddr*) &sa, sizeof(sa)) != 0 || listen(fd, 64) != 0
+                              : connect(fd, (struct sockaddr*) &sa, sizeof(sa)) != 0)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
 
-complex convert(int x, int y) {
-   return new_complex(
-        ((long double) x / IMG_W * (limitRight - limitLeft) + limitLeft) * zoom + offsetLeft,
-        ((long double) y / IMG_H * (limitBottom - limitTop) + limitTop) * zoom + offsetTop);
+    const char *colon = strrchr(addr, ':');
+    if (!colon) {
+        return -1;
+    }
+    std::string host(addr, colon - addr);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = server ? AI_PASSIVE : 0;
+    if (getaddrinfo(host.empty() ? NULL : host.c_str(), colon + 1, &hints, &res) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (server ? bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 64) != 0
+                   : connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
 }
 
-int juliaDot(complex z, int iter) {
-	int i;
-    for (i = 0; i < iter; i++) {
-        z = add_complex(mult_complex(z, z), c);
-        long double norm = module_complex(z);
-        if (norm > MAX_NORM) {
+// Délai maximal d'un recv/send bloquant sur fd
+void setTimeout(int fd, double seconds) {
+    struct timeval tv;
+    tv.tv_sec = (long) seconds;
+    tv.tv_usec = (long) ((seconds - tv.tv_sec) * 1e6);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// WORKER
+
+const char *workerAddr = NULL;
+
+// Une connexion par thread : reçoit des bandes, renvoie les itérations
+void* workerChild(void *arg) {
+    int fd = -1;
+    for (int attempt = 0; attempt < 100 && fd < 0; attempt++) {
+        fd = openSocket(workerAddr, false);
+        if (fd < 0) {
+            usleep(100000);  // le coordinateur n'écoute pas encore
+        }
+    }
+    uint32_t hello[2] = {MSG_HELLO, NET_MAGIC};
+    if (fd < 0 || !sendAll(fd, hello, sizeof(hello))) {
+        fprintf(stderr, "Cannot connect to %s\n", workerAddr);
+        return NULL;
+    }
+
+    view_t v;
+    setupView(&v, 0, 0, new_complex(0.0, 0.0), 0.0, 0.0, 0.0, 0);
+    std::vector<int> its;
+    tile_msg_t t;
+    long tiles = 0;
+    while (recvAll(fd, &t, sizeof(t)) && t.type == MSG_TILE) {
+        complex cc = new_complex(t.c[0], t.c[1]);
+        long double re = joinLd(t.center);
+        long double im = joinLd(t.center + 2);
+        long double step = joinLd(t.step);
+        // Les bandes d'une même image partagent les orbites de référence
+        if (v.w != t.w || v.h != t.h || v.c.real != cc.real || v.c.imag != cc.imag || v.centerRe != re
+            || v.centerIm != im || v.step != step || v.maxIter != t.maxIter || v.precision != t.precision) {
+            freeView(&v);
+            setupView(&v, t.w, t.h, cc, re, im, step, t.maxIter);
+            v.precision = (precision_t) t.precision;
+            viewOrbits(&v);
+        }
+        v.period = t.period != 0;
+        v.fractal = (fractal_t) t.fractal;
+
+        its.resize((size_t) t.rows * t.w);
+        for (int y = 0; y < t.rows; y++) {
+            viewRow(&v, t.y0 + y, &its[(size_t) y * t.w]);
+        }
+        result_msg_t r = {MSG_RESULT, t.tile, (uint32_t) its.size(), 0};
+        if (!sendAll(fd, &r, sizeof(r)) || !sendAll(fd, its.data(), its.size() * sizeof(int))) {
             break;
         }
+        tiles++;
     }
-    return i * 255 / iter; // on met i dans l'intervalle 0 à 255
+    freeView(&v);
+    close(fd);
+    if (verbose) {
+        fprintf(stderr, "Worker %ld: %ld tiles\n", (long) arg, tiles);
+    }
+    return NULL;
 }
 
-void julia(cv::Mat& img) {
-    for (int x = 0; x < IMG_W; x++) {
-        for (int y = 0; y < IMG_H; y++) {
-            int j = juliaDot(convert(x, y), maxIter);
-            cv::Vec3b color(j, j, j);
-            img.at<cv::Vec3b>(cv::Point(x, y)) = color;
+// julia_bw2 --worker ADDRESS [threads=N]
+int worker(int argc, char *argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: --worker ADDRESS [threads=N]\n");
+        return 1;
+    }
+    workerAddr = argv[0];
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int a = 1; a < argc; a++) {
+        if (strncmp(argv[a], "threads=", 8) == 0) {
+            threads = std::max(1, atoi(argv[a] + 8));
         }
+        else if (strncmp(argv[a], "verbose=", 8) == 0) {
+            verbose = atoi(argv[a] + 8) != 0;
+        }
+        else {
+            fprintf(stderr, "Bad option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    pthread_t tid[threads];
+    for (long j = 0; j < threads; j++) {
+        pthread_create(&tid[j], NULL, workerChild, (void*) j);
+    }
+    for (int j = 0; j < threads; j++) {
+        pthread_join(tid[j], NULL);
     }
+    return 0;
 }
 
-/* MAIN ***********************************************************************/
+// COORDINATEUR
 
-cv::Vec3b hsv2bgr(int h, float s, float v) {
-  int r, g, b;
-  int ti = (h / 60) % 6;
-  float f = h / 60.0 - ti;
-  int l = 255 * v * (1 - s);
-  int m = 255 * v * (1 - f * s);
-  int n = 255 * v * (1 - (1 - f) * s);
-  v *= 255;
-  switch (ti) {
-    case 0:
-      return cv::Vec3b(l, n, v);
-    case 1:
-      return cv::Vec3b(l, v, m);
-    case 2:
-      return cv::Vec3b(n, v, l);
-    case 3:
-      return cv::Vec3b(v, m, l);
-    case 4:
-      return cv::Vec3b(v, l, n);
-    default:
-    case 5:
-      return cv::Vec3b(m, l, v);
-  }
-}
+typedef struct {
+    int fd;
+    long tile;    // bande en cours (-1 : libre)
+    double sent;  // date d'envoi de la bande en cours
+} net_worker_t;
 
-void* child(void *arg) {
-    pthread_mutex_lock(&mutex);
-    while(1) {
-      int part;
-      while (nextPart >= nbParts && keepGoing) {
-        pthread_cond_wait(&cond, &mutex);
-      }
+// Comme pour --poster, seules quelques bandes sont en mémoire : les bandes
+// reçues attendent d'être écrites dans l'ordre, puis sont libérées. Aucune
+// bande n'est envoyée à plus de window bandes de la prochaine à écrire.
+typedef struct {
+    view_t view;
+    bool started;            // view est prête (une bande au moins est partie)
+    int bandsWritten;
+    std::vector<int*> its;   // par bande, les itérations reçues (NULL : pas encore)
+} net_frame_t;
 
-      if (!keepGoing) {
-        pthread_mutex_unlock(&mutex);
-        return NULL;
-      }
+// julia_bw2 --coordinator ADDRESS WIDTH HEIGHT FILE [option=value...]
+int coordinator(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: --coordinator ADDRESS WIDTH HEIGHT FILE [options]\n");
+        return 1;
+    }
+    const char *addr = argv[0];
+    int width = atoi(argv[1]);
+    int height = atoi(argv[2]);
+    const char *name = argv[3];
+    int band = 16;
+    int spawn = 0;
+    int threads = 1;      // threads de chaque worker lancé par spawn
+    int window = 64;      // bandes en mémoire (envoyées ou reçues) au plus
+    double timeout = 30.0;
+    int frames = 1;
+    complex center = new_complex(0.0, 0.0);
+    std::vector<complex> cs;
+    for (int a = 4; a < argc; a++) {
+        const char *eq = strchr(argv[a], '=');
+        std::string key(argv[a], eq ? eq - argv[a] : strlen(argv[a]));
+        const char *val = eq ? eq + 1 : "";
+        if (key == "c" || key == "center") {
+            parseC(val, cs);
+            if (!cs.empty()) {
+                (key == "c" ? c : center) = cs[0];
+            }
+        }
+        else if (key == "zoom") {
+            zoom = strtold(val, NULL);
+        }
+        else if (key == "maxiter") {
+            maxIter = std::max(1, atoi(val));
+        }
+        else if (key == "band") {
+            band = std::max(1, atoi(val));
+        }
+        else if (key == "spawn") {
+            spawn = std::max(0, atoi(val));
+        }
+        else if (key == "timeout") {
+            timeout = std::max(0.1, atof(val));
+        }
+        else if (key == "window") {
+            window = std::max(1, atoi(val));
+        }
+        else if (key == "path") {
+            if (!readPath(val)) {
+                fprintf(stderr, "Cannot read keyframes from %s\n", val);
+                return 1;
+            }
+        }
+        else if (key == "frames") {
+            frames = std::max(1, atoi(val));
+        }
+        else if (!parseViewOption(key, val, &threads)) {
+            fprintf(stderr, "Bad option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Bad size: %s x %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    if (keyframes.empty()) {
+        frames = 1;
+    }
+    else if (!strchr(name, '%')) {
+        fprintf(stderr, "With path=, FILE must be a pattern such as frame_%%05d.png\n");
+        return 1;
+    }
+    animFrames = frames;
 
-      part = nextPart++;
-      pthread_mutex_unlock(&mutex);
+    int server = openSocket(addr, true);
+    if (server < 0) {
+        fprintf(stderr, "Cannot listen on %s\n", addr);
+        return 1;
+    }
+    std::vector<pid_t> children;
+    for (int k = 0; k < spawn; k++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(server);
+            char opt[32];
+            snprintf(opt, sizeof(opt), "threads=%d", threads);
+            execl("/proc/self/exe", "julia_bw2", "--worker", addr, opt, "verbose=0", (char*) NULL);
+            _exit(127);
+        }
+        children.push_back(pid);
+    }
 
-      for (int i = part * partSize; i < IMG_H * IMG_W && i < (part + 1) * partSize; i++) {
-          int x = i % IMG_W;
-          int y = i / IMG_W;
-
-          int j = juliaDot(convert(x, y), maxIter);
-          cv::Vec3b color;
-          switch (colorMode) {
-            case BLACK_AND_WHITE:
-              newImg.at<cv::Vec3b>(cv::Point(x, y)) = cv::Vec3b(j, j, j);
-              break;
-            case PALETTE1:
-              color = cv::Vec3b(palette[j*3], palette[j*3+1], palette[j*3+2]);
-              newImg.at<cv::Vec3b>(cv::Point(x, y)) = color;
-              break;
-            case PALETTE2:
-              color = cv::Vec3b(palette2[j*3], palette2[j*3+1], palette2[j*3+2]);
-              newImg.at<cv::Vec3b>(cv::Point(x, y)) = color;
-              break;
-            case HUE:
-            default:
-              color = hsv2bgr(((j * 360) / 255 + offsetColor) % 360, 1.0, 1.0);
-              newImg.at<cv::Vec3b>(cv::Point(x, y)) = color;
-          }
-      }
+    int bands = (height + band - 1) / band;
+    long nbTiles = (long) frames * bands;
+    long nextTile = 0;
+    std::deque<long> retry;      // bandes perdues, à renvoyer en priorité
+    std::vector<net_worker_t> workers;
+    std::vector<net_frame_t> job(frames);
+    int written = 0;
+    long lost = 0;
+    bool ok = true;
+    image_writer_t iw;           // image job[written], ouverte à sa première bande
+    bool writing = false;
+    unsigned char *lut = NULL;   // couleurs de job[written]
+    unsigned char *row = (unsigned char*) malloc((size_t) width * 3);
+    initColorLuts();
+    fprintf(stderr, "%ld band(s) of %d x %d, at most %d in memory (%.1f MB)\n", nbTiles, width, band, window,
+            (double) window * band * width * sizeof(int) / 1048576.0);
+    double t0 = now();
+
+    while (written < frames) {
+        long head = (long) written * bands + job[written].bandsWritten; // prochaine bande à écrire
+        // Distribution : une bande par worker libre
+        for (size_t k = 0; k < workers.size(); k++) {
+            if (workers[k].tile >= 0) {
+                continue;
+            }
+            long t;
+            if (!retry.empty()) {
+                t = retry.front();
+                retry.pop_front();
+            }
+            else if (nextTile < nbTiles && nextTile < head + window) {
+                t = nextTile++;
+            }
+            else {
+                break;
+            }
+            net_frame_t& f = job[t / bands];
+            if (!f.started) {
+                int fi = t / bands;
+                if (keyframes.empty()) {
+                    setupView(&f.view, width, height, c, center.real, center.imag, viewStep(width, height, zoom), maxIter);
+                }
+                else {
+                    keyframe_t kf = pathAt(fi);
+                    setupView(&f.view, width, height, kf.c, kf.centerRe, kf.centerIm, viewStep(width, height, kf.zoom), kf.maxIter);
+                }
+                f.its.assign(bands, (int*) NULL);
+                f.bandsWritten = 0;
+                f.started = true;
+            }
+            tile_msg_t m;
+            memset(&m, 0, sizeof(m));
+            m.type = MSG_TILE;
+            m.tile = t;
+            m.w = width;
+            m.h = height;
+            m.y0 = (t % bands) * band;
+            m.rows = std::min(height - m.y0, band);
+            m.maxIter = f.view.maxIter;
+            m.precision = f.view.precision;
+            m.period = f.view.period;
+            m.fractal = f.view.fractal;
+            m.c[0] = f.view.c.real;
+            m.c[1] = f.view.c.imag;
+            splitLd(f.view.centerRe, m.center);
+            splitLd(f.view.centerIm, m.center + 2);
+            splitLd(f.view.step, m.step);
+            workers[k].tile = t;
+            workers[k].sent = now();
+            if (!sendAll(workers[k].fd, &m, sizeof(m))) {
+                workers[k].sent = 0.0;  // traité comme un dépassement de délai
+            }
+        }
+
+        std::vector<struct pollfd> fds(workers.size() + 1);
+        fds[0].fd = server;
+        fds[0].events = POLLIN;
+        for (size_t k = 0; k < workers.size(); k++) {
+            fds[k + 1].fd = workers[k].fd;
+            fds[k + 1].events = POLLIN;
+        }
+        poll(fds.data(), fds.size(), 100);
+        size_t polled = fds.size() - 1; // les workers acceptés ci-dessous n'ont pas été surveillés
+
+        // Nouveau worker
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(server, NULL, NULL);
+            uint32_t hello[2];
+            if (fd >= 0) {
+                setTimeout(fd, timeout);
+                if (recvAll(fd, hello, sizeof(hello)) && hello[0] == MSG_HELLO && hello[1] == NET_MAGIC) {
+                    net_worker_t w = {fd, -1, 0.0};
+                    workers.push_back(w);
+                }
+                else {
+                    fprintf(stderr, "Rejected a worker (bad handshake)\n");
+                    close(fd);
+                }
+            }
+        }
+
+        // Résultats, workers perdus
+        double t = now();
+        for (size_t k = polled; k-- > 0; ) {
+            net_worker_t& w = workers[k];
+            bool alive = true;
+            if (fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                result_msg_t r;
+                alive = recvAll(w.fd, &r, sizeof(r)) && r.type == MSG_RESULT && (long) r.tile == w.tile;
+                if (alive) {
+                    int*& its = job[w.tile / bands].its[w.tile % bands];
+                    int y0 = (w.tile % bands) * band;
+                    alive = r.count == (uint32_t) (std::min(height - y0, band) * width);
+                    if (alive && !its) {
+                        its = (int*) malloc(r.count * sizeof(int));
+                    }
+                    alive = alive && recvAll(w.fd, its, r.count * sizeof(int));
+                    if (!alive) {
+                        free(its); // bande incomplète : elle sera renvoyée
+                        its = NULL;
+                    }
+                }
+                if (alive) {
+                    w.tile = -1;
+                }
+            }
+            else if (w.tile >= 0 && t - w.sent > timeout) {
+                alive = false;
+            }
+            if (!alive) {
+                if (w.tile >= 0) {
+                    retry.push_back(w.tile);
+                    lost++;
+                }
+                close(w.fd);
+                workers.erase(workers.begin() + k);
+                fprintf(stderr, "\nLost a worker, %d left\n", (int) workers.size());
+            }
+        }
+
+        // Écriture des bandes reçues, dans l'ordre, et libération
+        while (written < frames && job[written].started && job[written].its[job[written].bandsWritten]) {
+            net_frame_t& f = job[written];
+            char file[1024];
+            snprintf(file, sizeof(file), name, written);
+            int b = f.bandsWritten;
+            if (b == 0) {
+                lut = newRgbLut(f.view.maxIter);
+                writing = openImage(&iw, file, width, height);
+                if (!writing) {
+                    fprintf(stderr, "Cannot write %s\n", file);
+                    ok = false;
+                }
+            }
+            int rows = std::min(height - b * band, band);
+            for (int y = 0; writing && y < rows; y++) {
+                for (int x = 0; x < width; x++) {
+                    memcpy(row + 3 * x, lut + 3 * std::min(f.its[b][(size_t) y * width + x], f.view.maxIter), 3);
+                }
+                writing = writeImageRows(&iw, row, 1);
+                if (!writing) {
+                    closeImage(&iw);
+                    fprintf(stderr, "Cannot write %s\n", file);
+                    ok = false;
+                }
+            }
+            free(f.its[b]);
+            f.its[b] = NULL;
+            if (++f.bandsWritten == bands) {
+                if (writing && !closeImage(&iw)) {
+                    fprintf(stderr, "Cannot write %s\n", file);
+                    ok = false;
+                }
+                writing = false;
+                free(lut);
+                lut = NULL;
+                written++;
+            }
+        }
+        fprintf(stderr, "\r%d / %d frames, %ld / %ld tiles, %d workers",
+                written, frames, std::min(nextTile, nbTiles) - (long) retry.size(), nbTiles, (int) workers.size());
     }
-    pthread_mutex_unlock(&mutex);
 
-    return NULL;
+    free(row);
+
+    tile_msg_t bye;
+    memset(&bye, 0, sizeof(bye));
+    bye.type = MSG_BYE;
+    for (size_t k = 0; k < workers.size(); k++) {
+        sendAll(workers[k].fd, &bye, sizeof(bye));
+        close(workers[k].fd);
+    }
+    close(server);
+    if (strncmp(addr, "unix:", 5) == 0) {
+        unlink(addr + 5);
+    }
+    // Un worker lancé trop tard pour avoir du travail attend encore le coordinateur
+    for (size_t k = 0; k < children.size(); k++) {
+        kill(children[k], SIGKILL);
+        waitpid(children[k], NULL, 0);
+    }
+    fprintf(stderr, "\n%s %d frame(s) in %.1f s, %ld tile(s) resent\n",
+            ok ? "Wrote" : "Failed to write", frames, now() - t0, lost);
+    return ok ? 0 : 1;
 }
 
 int main(int argc, char * argv[]) {
@@ -185,11 +3474,56 @@ int main(int argc, char * argv[]) {
     float reel = -1.41702285618f;
     float imag = 0.0f;
 
-    printf("Usage: %s [Number of threads [Number of parts per thread [Initial real part [Initial imaginary part]]]]\n"
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+      return bench(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--poster") == 0) {
+      return poster(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--animate") == 0) {
+      return animate(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--coordinator") == 0) {
+      return coordinator(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--worker") == 0) {
+      return worker(argc - 2, argv + 2);
+    }
+
+    printf("Usage: %s [Number of threads [Tile size [Initial real part [Initial imaginary part]]]]\n"
+      "                 [cache=%d] [spill=FILE] [spillsize=%d] [fractal=julia]\n"
+      "                 [aa=0] [aathreshold=%d]\n"
       "- Number of threads: integer higher or equal to 1\n"
-      "- Number of parts per thread: integer higher or equal to 1\n"
+      "- Tile size: side in pixels of the square tiles shared between threads (default: %d)\n"
       "- Initial real part: float (real part of the complex number c used to compute the julia set)\n"
-      "- Initial imaginary part: float (imaginary part of the complex number c used to compute the julia set)\n", argv[0]);
+      "- Initial imaginary part: float (imaginary part of the complex number c used to compute the julia set)\n"
+      "- cache: memory in MB kept for the iterations of views already seen (0: no cache)\n"
+      "- spill, spillsize: file (and its size in MB) receiving the tiles evicted from memory\n"
+      "- fractal: julia (z^2 + c), julia3, julia4, julia5 (z^d + c), mandelbrot, burningship or tricorn\n"
+      "  (for the last three the pixel is c and z starts at 0)\n"
+      "- aa: subsamples (4 to 64) computed for the edge pixels after each frame (0: no antialiasing), aathreshold:\n"
+      "  minimum difference of iterations with a neighbour for a pixel to be an edge pixel\n",
+      argv[0], CACHE_DEFAULT_MB, SPILL_DEFAULT_MB, AA_THRESHOLD, TILE_SIZE);
+    printf("   or: %s --bench [threads=1,2,4] [tiles=32] [c=-1:1:0.2 or c=-0.8/0.156,...] [maxiter=300]\n"
+      "                 [precision=auto,float,...] [simd=scalar,AVX2,AVX-512] [warmup=1] [reps=5] [symmetry=1]\n"
+      "                 [fractal=julia] [aa=0] [aathreshold=%d]\n"
+      "- Renders full frames for every combination of the lists and prints one CSV line each:\n"
+      "  threads,tile size,real,imag,median (s),p95 (s),maxIter,precision,simd,Mpixel/s,Giter/s\n", argv[0],
+      AA_THRESHOLD);
+    printf("   or: %s --poster WIDTH HEIGHT FILE [c=-0.8/0.156] [center=0/0] [zoom=1] [maxiter=300]\n"
+      "                 [color=hue|bw|palette1|palette2] [precision=...] [period=1] [fractal=...] [band=64]\n"
+      "                 [threads=N]\n"
+      "- Renders a WIDTH x HEIGHT image without a window, band by band, to FILE (.png, otherwise binary PPM)\n", argv[0]);
+    printf("   or: %s --animate PATH FRAMES OUTPUT [width=1024] [height=1024] [fps=25] [inflight=3] [band=16]\n"
+      "                 [format=y4m|bgr] [color=...] [precision=...] [period=1] [fractal=...] [threads=N]\n"
+      "- Renders FRAMES frames along the keyframes of PATH (one per line: c_re c_im center_re center_im zoom maxIter)\n"
+      "  to stdout (OUTPUT = -, y4m or raw BGR) or to numbered files (OUTPUT = frame_%%05d.png)\n", argv[0]);
+    printf("   or: %s --coordinator ADDRESS WIDTH HEIGHT FILE [poster options] [spawn=0] [band=16] [timeout=30]\n"
+      "                 [window=64] [path=PATH frames=N]\n"
+      "- Same as --poster (or --animate with path=, FILE being a pattern), the bands being computed by workers\n"
+      "  connected to ADDRESS (unix:/path or host:port); spawn=N starts N local workers\n"
+      "   or: %s --worker ADDRESS [threads=N]\n"
+      "- Computes bands for the coordinator at ADDRESS\n", argv[0], argv[0]);
     printf("\n");
     printf("Commands:\n"
       "- LEFT and RIGHT arrows: move the camera horizontaly\n"
@@ -199,67 +3533,175 @@ int main(int argc, char * argv[]) {
       "- d and q: increase or decrease the real part of the complex number c used to compute the julia set\n"
       "- t and g: increase or decrease the hue offset (only works with the initial colore mode)\n"
       "- e and a: zoom in or out\n"
+      "- p: switch between automatic and forced precision (float, double, long double, perturbation)\n"
+      "- m: enable or disable Mariani-Silver subdivision (uniform rectangles are filled without being computed)\n"
+      "- v: enable or disable the verification of Mariani-Silver against brute force\n"
+      "- o: enable or disable periodicity checking (periodic orbits stop before the maximum number of iterations)\n"
+      "- y: enable or disable symmetry (pixels whose mirror, -z or conj(z) depending on the fractal, is in the image\n"
+      "  are copied instead of computed)\n"
+      "- k: enable or disable antialiasing (edge pixels are refined with subsamples once the frame is done)\n"
+      "- x: switch between fractals (julia, julia3, julia4, julia5, mandelbrot, burningship, tricorn)\n"
+      "- i: show or hide the per-thread statistics and the iterations per tile\n"
+      "- h: print the histograms of the input to display latency and of the frame time (also printed on exit)\n"
+      "- j: start or stop writing the statistics of every frame to " STATS_FILE "\n"
       "- SPACE: switch between multiple color modes\n"
       "- w: save the current image\n"
       "- q: quit\n");
 
-    // Récupération des paramètres;
-    if (argc > 1) {
+    // Récupération des paramètres (positionnels, puis option=valeur);
+    int nbArgs = 1;
+    while (nbArgs < argc && !strchr(argv[nbArgs], '=')) {
+      nbArgs++;
+    }
+    if (nbArgs > 1) {
       nbThreads = atoi(argv[1]);
     }
-    if (argc > 2) {
-      nbPartsPerThread = atoi(argv[2]);
+    activeThreads = nbThreads;
+    if (nbArgs > 2) {
+      tileSize = std::max(1, atoi(argv[2]) / 8) * 8; // multiple du pas de la première passe
     }
-    if (argc > 3) {
+    if (nbArgs > 3) {
       reel = atof(argv[3]);
     }
-    if (argc > 4) {
+    if (nbArgs > 4) {
       imag = atof(argv[4]);
     }
-
-    nbParts = nbThreads * nbPartsPerThread;
-    
-    partSize = IMG_H * IMG_W;
-    if (partSize % nbParts != 0) {
-        partSize += nbParts - partSize % nbParts;
+    cacheLimit = (long) CACHE_DEFAULT_MB << 20;
+    for (int a = nbArgs; a < argc; a++) {
+      if (strncmp(argv[a], "cache=", 6) == 0) {
+        cacheLimit = atol(argv[a] + 6) << 20;
+      }
+      else if (strncmp(argv[a], "spill=", 6) == 0) {
+        spillName = argv[a] + 6;
+      }
+      else if (strncmp(argv[a], "spillsize=", 10) == 0) {
+        spillLimit = atol(argv[a] + 10) << 20;
+      }
+      else if (strncmp(argv[a], "fractal=", 8) == 0) {
+        std::vector<int> names;
+        if (!parseNames(argv[a] + 8, fractalNames, FRACTALS, names)) {
+          return 1;
+        }
+        fractal = (fractal_t) names[0];
+      }
+      else if (strncmp(argv[a], "aa=", 3) == 0) {
+        setAntialias(atoi(argv[a] + 3));
+      }
+      else if (strncmp(argv[a], "aathreshold=", 12) == 0) {
+        aaThreshold = atoi(argv[a] + 12);
+      }
+      else {
+        fprintf(stderr, "Bad option: %s\n", argv[a]);
+        return 1;
+      }
+    }
+    if (cacheLimit > 0) {
+      initCache();
     }
-    partSize /= nbParts;
-    
+
+    initTiles();
+
     c = new_complex(reel, imag);
+    printf("SIMD kernel: %s\n", simdNames[simdLevel]);
+    initColorLuts();
 
+    if (!initStats()) {
+        fprintf(stderr, "Not enough memory for %d threads\n", nbThreads);
+        return 1;
+    }
     pthread_t tid[nbThreads];
     for (int j = 0; j < nbThreads; j++) {
-        pthread_create(&tid[j], NULL, child, NULL);
+        pthread_create(&tid[j], NULL, child, (void*) (long) j);
     }
+    presenting = true;
+    startFrame(FRAME_FULL);
 
+    bool dirty = true;     // l'image affichée ne reflète pas encore le tampon avant
+    unsigned shown = 0;    // dernière passe affichée (presentSeq)
+    int dumped = 0;        // dernière image écrite dans statsFile
+    int cached = 0;        // dernière image rangée dans le cache
+    double inputAt = 0.0;  // touche pas encore affichée (0 : aucune)
+    unsigned inputSeq = 0; // passes échangées au moment de la touche
+    bool inputRender = false;
     while (keepGoing) {
       // printf("%Lf, %Lf\n", c.real, c.imag);
+        // une passe terminée réveille l'affichage tout de suite
+        bool final;
+        unsigned seq = waitPresent(shown, dirty ? 0 : KEY_POLL_MS, &final);
+        bool fresh = dirty || seq != shown;
+        if (fresh) {
+          recolor();
+          if (showStats) {
+            drawStats(newImg);
+          }
+          // cv::cvtColor(newImg, newImg, cv::COLOR_HSV2BGR);
+          imshow("image", newImg); // met à jour l'image
+          dirty = false;
+        }
+        int key = cv::waitKey(1); // -1 indique qu'aucune touche est enfoncée
+        double t = now();
+        if (fresh && inputAt > 0.0 && (!inputRender || seq != inputSeq)) {
+          lastLatency = (t - inputAt) * 1e3;
+          histAdd(&latencyHist, lastLatency);
+          inputAt = 0.0;
+        }
+        if (fresh && final && seq != shown) {
+          lastPresent = (t - frameStart) * 1e3;
+          histAdd(&frameHist, lastPresent);
+        }
+        shown = seq;
 
-        // cv::cvtColor(newImg, newImg, cv::COLOR_HSV2BGR);
-        imshow("image", newImg); // met à jour l'image
-        int key = -1; // -1 indique qu'aucune touche est enfoncée
+        bool done = __atomic_load_n(&frameDone, __ATOMIC_SEQ_CST);
+        if (statsFile && done && final && dumped != frameCount) { // après l'affichage de la dernière passe
+          dumpStats(statsFile);
+          dumped = frameCount;
+        }
+        if (done && cached != frameCount) {
+          cacheStore();
+          cached = frameCount;
+        }
 
-        if( (key = cv::waitKey(30)) != -1) {
+        if (key != -1) {
+          // les couleurs ne demandent pas de recalcul, une baisse de maxIter
+          // se lit dans les nombres d'itérations déjà connus
+          // couper l'anticrénelage d'une image terminée revient à ne plus l'afficher
+          bool noRender = key == 't' || key == 'g' || key == 'w' || key == 'i' || key == 'j' || key == 'h'
+                          || key == 32 || ((key == 'r' || (key == 'k' && antialias)) && frameDone);
+          if (!noRender) {
+            cancelFrame();
+          }
+          // latence mesurée jusqu'à l'affichage de la première passe de la
+          // nouvelle image (ou, sans recalcul, jusqu'au prochain affichage)
+          pthread_mutex_lock(&displayMutex);
+          inputSeq = presentSeq;
+          pthread_mutex_unlock(&displayMutex);
+          inputAt = t;
+          inputRender = !noRender;
+          frame_mode_t mode = FRAME_FULL;
           if (key == 81) { // Left key
-            offsetLeft -= STEP * zoom;
+            mode = pan(-panPixels(), 0) ? FRAME_PAN : FRAME_FULL;
           }
           else if (key == 83) { // Right key
-            offsetLeft += STEP * zoom;
+            mode = pan(panPixels(), 0) ? FRAME_PAN : FRAME_FULL;
           }
           else if (key == 82) { // Up key
-            offsetTop -= STEP * zoom;
+            mode = pan(0, -panPixels()) ? FRAME_PAN : FRAME_FULL;
           }
           else if (key == 84) { // Down key
-            offsetTop += STEP * zoom;
+            mode = pan(0, panPixels()) ? FRAME_PAN : FRAME_FULL;
           }
           else if (key == 'r' && maxIter > 10) {
             maxIter -= 10;
           }
           else if (key == 'f') {
+            if (frameDone && canResume()) {
+              mode = FRAME_RESUME;
+            }
             maxIter += 10;
           }
           else if (key == 'a') {
             zoom /= 0.5;
+            alignView();
           }
           else if (key == 'e') {
             zoom *= 0.5;
@@ -291,27 +3733,95 @@ int main(int argc, char * argv[]) {
             time(&timer);
             tm_info = localtime(&timer);
             strftime(name, 100, "img_julia_%Y%m%d_%H%M%S.bmp", tm_info);
+            recolor();
             imwrite(name, newImg);
             printf("Image saved\n");
           }
+          else if (key == 'p') {
+            forcedPrecision = (precision_t) (((int) forcedPrecision + 1) % (int) PRECISIONS);
+            printf("Precision: %s (%s)\n", precisionNames[forcedPrecision], precisionNames[currentPrecision()]);
+          }
+          else if (key == 'm') {
+            marianiSilver = !marianiSilver;
+            printf("Mariani-Silver: %s\n", marianiSilver ? "on" : "off");
+          }
+          else if (key == 'v') {
+            verifyFill = !verifyFill;
+            printf("Mariani-Silver verification: %s\n", verifyFill ? "on" : "off");
+          }
+          else if (key == 'o') {
+            periodCheck = !periodCheck;
+            printf("Periodicity checking: %s\n", periodCheck ? "on" : "off");
+          }
+          else if (key == 'y') {
+            symmetry = !symmetry;
+            printf("Symmetry: %s\n", symmetry ? "on" : "off");
+          }
+          else if (key == 'k') {
+            if (frameDone && !antialias) {
+              mode = FRAME_AA; // les itérations de l'image sont toutes connues
+            }
+            antialias = !antialias;
+            if (!antialias) {
+              aaPixels = 0;
+            }
+            printf("Antialiasing: %s\n", antialias ? "on" : "off");
+          }
+          else if (key == 'x') {
+            fractal = (fractal_t) (((int) fractal + 1) % (int) FRACTALS);
+            printf("Fractal: %s (%s)\n", fractalNames[fractal], precisionNames[currentPrecision()]);
+          }
+          else if (key == 'i') {
+            showStats = !showStats;
+          }
+          else if (key == 'h') {
+            printHistogram("Input to display latency", &latencyHist);
+            printHistogram("Frame time", &frameHist);
+          }
+          else if (key == 'j') {
+            if (statsFile) {
+              fclose(statsFile);
+              statsFile = NULL;
+              printf("Statistics dump: off\n");
+            }
+            else {
+              statsFile = fopen(STATS_FILE, "a");
+              dumped = frameCount; // à partir de la prochaine image
+              printf("Statistics dump: %s\n", statsFile ? STATS_FILE : "cannot open " STATS_FILE);
+            }
+          }
           else if (key == 32) { // Space
             colorMode = (color_mode_t) (((int) colorMode + 1) % (int) COLOR_MODES);
           }
           else if (key == 27) { // Escape
             keepGoing = false;
           }
-          pthread_mutex_lock(&mutex);
-          nextPart = 0;
-          pthread_cond_broadcast(&cond);
-          pthread_mutex_unlock(&mutex);
+          if (keepGoing && !noRender) {
+            startFrame(mode); // sa première passe rafraîchira l'image
+          }
+          dirty = noRender;
         }
     }
+    if (verbose) {
+      printHistogram("Input to display latency", &latencyHist);
+      printHistogram("Frame time", &frameHist);
+    }
     cvDestroyWindow("image"); // ferme la fenêtre
 
+    pthread_mutex_lock(&mutex);
     pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
     for (int j = 0; j < nbThreads; j++) {
         pthread_join(tid[j], NULL);
     }
 
+    free_ref_orbit(refOrbit);
+    free_ref_orbit(critOrbit);
+    free(iterLut);
+    freeCache();
+    if (statsFile) {
+      fclose(statsFile);
+    }
+
     return 0;
 }
@@ -0,0 +1,870 @@
+#ifndef KERNELS_H_INCLUDED
+#define KERNELS_H_INCLUDED
+
+// Noyaux de calcul "escape-time" vectorisés (AVX2 / AVX-512) avec choix à
+// l'exécution selon le processeur. Les vecteurs utilisent les extensions de
+// GCC : le même code générique est compilé pour chaque jeu d'instructions
+// via l'attribut target des fonctions d'entrée, et pour chaque fractale
+// (paramètre de template) : la formule est choisie une fois par segment,
+// pas par pixel.
+
+#include <stdlib.h>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+#ifndef MAX_NORM
+#define MAX_NORM 4
+#endif
+
+/* TYPES VECTORIELS ***********************************************************/
+
+typedef double v4d __attribute__((vector_size(32)));
+typedef long long v4l __attribute__((vector_size(32)));
+typedef double v8d __attribute__((vector_size(64)));
+typedef long long v8l __attribute__((vector_size(64)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef int v8i __attribute__((vector_size(32)));
+typedef float v16f __attribute__((vector_size(64)));
+typedef int v16i __attribute__((vector_size(64)));
+
+typedef enum {
+  SIMD_SCALAR = 0,
+  SIMD_AVX2,
+  SIMD_AVX512,
+  SIMD_LEVELS
+} simd_level_t;
+
+static const char* const simdNames[] = {"scalar", "AVX2", "AVX-512"};
+
+inline simd_level_t detectSimd() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    return SIMD_SCALAR;
+}
+
+// Jeu d'instructions utilisé, modifiable (--bench simd=...). Ce fichier
+// n'a pas de .cpp : la variable est le membre statique d'un template, dont
+// l'éditeur de liens ne garde qu'un exemplaire quel que soit le nombre
+// d'unités de compilation qui incluent l'en-tête.
+template<typename T>
+struct simd_state_t {
+    static simd_level_t level;
+};
+template<typename T>
+simd_level_t simd_state_t<T>::level = detectSimd();
+static simd_level_t& simdLevel = simd_state_t<void>::level;
+
+// Formules. Pour les ensembles de Julia, le pixel est z0 et c est fixé ;
+// pour les autres, le pixel est c et z0 = 0.
+typedef enum {
+  FRACTAL_JULIA = 0,    // z² + c
+  FRACTAL_JULIA3,       // z³ + c
+  FRACTAL_JULIA4,       // z⁴ + c
+  FRACTAL_JULIA5,       // z⁵ + c
+  FRACTAL_MANDELBROT,   // z² + pixel
+  FRACTAL_BURNING_SHIP, // (|x| + i |y|)² + pixel
+  FRACTAL_TRICORN,      // conj(z)² + pixel
+  FRACTALS
+} fractal_t;
+
+static const char* const fractalNames[] = {"julia", "julia3", "julia4", "julia5", "mandelbrot", "burningship", "tricorn"};
+
+// Le pixel donne c (et non z0)
+static inline bool pixelIsC(int f) {
+    return f >= FRACTAL_MANDELBROT;
+}
+
+/* NOYAU GENERIQUE ************************************************************/
+
+template<typename M, int N>
+static inline __attribute__((always_inline)) bool anyLane(const M& m) {
+    long long r = 0;
+    for (int k = 0; k < N; k++) {
+        r |= m[k];
+    }
+    return r != 0;
+}
+
+// Tolérance de la détection de cycles : quelques ulps de la précision
+// utilisée (les orbites sont bornées par 2 en module)
+template<typename T>
+static inline T periodEps() {
+    return std::numeric_limits<T>::epsilon() * 16;
+}
+
+// Une itération de la formule F : (nzr, nzi) = f(zr, zi) + (cr, ci), avec
+// zr2 = zr² et zi2 = zi². V est un vecteur ou un scalaire de type T, C est
+// T (c commun à tous les pixels) ou V (un c par pixel). Le switch porte sur
+// une constante et disparaît à la compilation.
+template<int F, typename T, typename V, typename C>
+static inline __attribute__((always_inline))
+void stepT(V& nzr, V& nzi, const V& zr, const V& zi, const V& zr2, const V& zi2, const C& cr, const C& ci) {
+    switch (F) {
+      case FRACTAL_JULIA3:
+        nzr = zr * (zr2 - (T) 3 * zi2) + cr;
+        nzi = zi * ((T) 3 * zr2 - zi2) + ci;
+        break;
+      case FRACTAL_JULIA4: {
+        V a = zr2 - zi2;
+        V b = (zr + zr) * zi;
+        nzr = a * a - b * b + cr;
+        nzi = (a + a) * b + ci;
+        break;
+      }
+      case FRACTAL_JULIA5: {
+        V a = zr2 - zi2;
+        V b = (zr + zr) * zi;
+        V a4 = a * a - b * b;
+        V b4 = (a + a) * b;
+        nzr = a4 * zr - b4 * zi + cr;
+        nzi = a4 * zi + b4 * zr + ci;
+        break;
+      }
+      case FRACTAL_BURNING_SHIP: {
+        V p = (zr + zr) * zi;
+        nzi = (p < (T) 0 ? -p : p) + ci;
+        nzr = zr2 - zi2 + cr;
+        break;
+      }
+      case FRACTAL_TRICORN:
+        nzi = ci - (zr + zr) * zi;
+        nzr = zr2 - zi2 + cr;
+        break;
+      default: // z² : Julia et Mandelbrot
+        nzi = (zr + zr) * zi + ci;
+        nzr = zr2 - zi2 + cr;
+        break;
+    }
+}
+
+// Itère les N orbites (zr, zi) qui en sont à cnt itérations, au plus
+// steps fois. Un pixel s'arrête quand il diverge ou quand cnt atteint maxIter
+// (avec RESUME, les pixels ne partent pas tous du même nombre d'itérations).
+// Avec PERIOD, on compare z à un point de contrôle déplacé aux itérations
+// 1, 2, 4, 8... (méthode de Brent) : si l'orbite revient sur ce point, elle
+// est périodique et ne divergera jamais, on s'arrête donc tout de suite.
+// Au retour, z est figé à la première valeur qui dépasse MAX_NORM (ou à la
+// dernière si le point n'a pas divergé) ; iterateScalarT garde la même.
+template<int F, typename T, typename V, typename M, int N, bool PERIOD, bool RESUME, typename C>
+static inline __attribute__((always_inline))
+void iterateT(V& zr, V& zi, M& cnt, M& cycle, const C& cr, const C& ci, int maxIter, int steps) {
+    const T eps = periodEps<T>();
+    V zr2 = zr * zr;
+    V zi2 = zi * zi;
+    V sr = zr;
+    V si = zi;
+    M active = RESUME ? cnt < maxIter : cnt == cnt; // tous les bits à 1
+    cycle = cnt != cnt;
+    int check = 1;
+
+    for (int k = 0; k < steps; k++) {
+        V nzr, nzi;
+        stepT<F, T>(nzr, nzi, zr, zi, zr2, zi2, cr, ci);
+        // on fige z dès qu'un pixel a divergé
+        zr = active ? nzr : zr;
+        zi = active ? nzi : zi;
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        active &= (zr2 + zi2 <= (T) MAX_NORM);
+        cnt -= active;
+        if (RESUME) {
+            active &= cnt < maxIter;
+        }
+        if (PERIOD) {
+            V dr = zr - sr;
+            V di = zi - si;
+            dr = dr < (T) 0 ? -dr : dr;
+            di = di < (T) 0 ? -di : di;
+            M same = active & (dr + di <= eps);
+            cycle |= same;
+            active &= ~same;
+            if (k + 1 == check) {
+                sr = zr;
+                si = zi;
+                check <<= 1;
+            }
+        }
+        if ((k & 7) == 7 && !anyLane<M, N>(active)) {
+            break;
+        }
+    }
+}
+
+// Calcule n pixels alignés sur un segment : le pixel k est
+// (re0 + k * dre, im0 + k * dim). out[k] reçoit le nombre d'itérations
+// avant divergence (maxIter si le point ne diverge pas).
+// Si zr et zi ne sont pas NULL, ils reçoivent z après maxIter itérations
+// pour les points qui n'ont pas divergé (NAN si l'orbite est périodique),
+// ce qui permet de reprendre le calcul avec escapeResume.
+// Retourne le nombre d'itérations effectuées, *saved reçoit celles évitées.
+template<int F, typename T, typename V, typename M, int N, bool PERIOD>
+static inline __attribute__((always_inline))
+long escapeSpanT(T re0, T im0, T dre, T dim, int n, T cr, T ci, int maxIter, int *out, long *saved,
+                 double *zrOut, double *ziOut) {
+    long total = 0;
+    V lane;
+    for (int k = 0; k < N; k++) {
+        lane[k] = k;
+    }
+
+    for (int i = 0; i < n; i += N) {
+        V idx = lane + (T) i;
+        V pr = re0 + idx * dre;
+        V pi = im0 + idx * dim;
+        M cnt = {};
+        M cycle;
+        V zr, zi;
+        if (pixelIsC(F)) {
+            zr = pr - pr;
+            zi = zr;
+            iterateT<F, T, V, M, N, PERIOD, false>(zr, zi, cnt, cycle, pr, pi, maxIter, maxIter);
+        }
+        else {
+            zr = pr;
+            zi = pi;
+            iterateT<F, T, V, M, N, PERIOD, false>(zr, zi, cnt, cycle, cr, ci, maxIter, maxIter);
+        }
+
+        for (int k = 0; k < N && i + k < n; k++) {
+            out[i + k] = cycle[k] ? maxIter : cnt[k];
+            total += cnt[k];
+            if (cycle[k] && saved) {
+                *saved += maxIter - cnt[k];
+            }
+            if (zrOut) {
+                zrOut[i + k] = cycle[k] ? NAN : zr[k];
+                ziOut[i + k] = cycle[k] ? NAN : zi[k];
+            }
+        }
+    }
+    return total;
+}
+
+// Reprend n orbites arrêtées : le pixel k en est à its[k] itérations avec
+// z = (zr[k], zi[k]). On continue jusqu'à maxIter ; its, zr et zi sont mis à
+// jour comme pour escapeSpanT. Ensembles de Julia seulement (c commun).
+template<int F, typename T, typename V, typename M, int N, bool PERIOD>
+static inline __attribute__((always_inline))
+long escapeResumeT(double *zrIo, double *ziIo, int *its, int n, T cr, T ci, int maxIter, long *saved) {
+    long total = 0;
+    for (int i = 0; i < n; i += N) {
+        V zr, zi;
+        M cnt;
+        M start;
+        int first = maxIter;
+        for (int k = 0; k < N; k++) {
+            bool used = i + k < n;
+            zr[k] = used ? zrIo[i + k] : 0;
+            zi[k] = used ? ziIo[i + k] : 0;
+            cnt[k] = used ? its[i + k] : maxIter;
+            first = std::min(first, (int) cnt[k]);
+        }
+        start = cnt;
+        M cycle;
+        iterateT<F, T, V, M, N, PERIOD, true>(zr, zi, cnt, cycle, cr, ci, maxIter, maxIter - first);
+
+        for (int k = 0; k < N && i + k < n; k++) {
+            its[i + k] = cycle[k] ? maxIter : cnt[k];
+            total += cnt[k] - start[k];
+            if (cycle[k] && saved) {
+                *saved += maxIter - cnt[k];
+            }
+            zrIo[i + k] = cycle[k] ? NAN : zr[k];
+            ziIo[i + k] = cycle[k] ? NAN : zi[k];
+        }
+    }
+    return total;
+}
+
+template<typename T>
+static inline T absT(T x) {
+    return x < 0 ? -x : x;
+}
+
+// Version scalaire de iterateT pour un pixel. Retourne le nombre
+// d'itérations atteint, *cycle indique une orbite périodique.
+template<int F, typename T>
+static inline __attribute__((always_inline))
+int iterateScalarT(T& zr, T& zi, int i, T cr, T ci, int maxIter, bool period, bool *cycle) {
+    const T eps = periodEps<T>();
+    T sr = zr;
+    T si = zi;
+    int check = 1;
+    *cycle = false;
+    for (int k = 0; i < maxIter; i++, k++) {
+        T r, nzi;
+        stepT<F, T>(r, nzi, zr, zi, zr * zr, zi * zi, cr, ci);
+        zr = r;
+        zi = nzi;
+        if (zr * zr + zi * zi > (T) MAX_NORM) {
+            break;
+        }
+        if (period) {
+            if (absT(zr - sr) + absT(zi - si) <= eps) {
+                *cycle = true;
+                return i + 1;
+            }
+            if (k + 1 == check) {
+                sr = zr;
+                si = zi;
+                check <<= 1;
+            }
+        }
+    }
+    return i;
+}
+
+template<int F, typename T>
+static inline __attribute__((always_inline))
+long escapeSpanScalarT(T re0, T im0, T dre, T dim, int n, T cr, T ci, int maxIter, int *out,
+                       bool period, long *saved, double *zrOut, double *ziOut) {
+    long total = 0;
+    for (int k = 0; k < n; k++) {
+        T zr = re0 + k * dre;
+        T zi = im0 + k * dim;
+        bool cycle;
+        int i;
+        if (pixelIsC(F)) {
+            T pr = zr;
+            T pi = zi;
+            zr = 0;
+            zi = 0;
+            i = iterateScalarT<F, T>(zr, zi, 0, pr, pi, maxIter, period, &cycle);
+        }
+        else {
+            i = iterateScalarT<F, T>(zr, zi, 0, cr, ci, maxIter, period, &cycle);
+        }
+        out[k] = cycle ? maxIter : i;
+        if (cycle && saved) {
+            *saved += maxIter - i;
+        }
+        if (zrOut) {
+            zrOut[k] = cycle ? NAN : (double) zr;
+            ziOut[k] = cycle ? NAN : (double) zi;
+        }
+        total += i;
+    }
+    return total;
+}
+
+template<int F, typename T>
+static inline __attribute__((always_inline))
+long escapeResumeScalarT(double *zrIo, double *ziIo, int *its, int n, T cr, T ci, int maxIter,
+                         bool period, long *saved) {
+    long total = 0;
+    for (int k = 0; k < n; k++) {
+        T zr = zrIo[k];
+        T zi = ziIo[k];
+        bool cycle;
+        int i = iterateScalarT<F, T>(zr, zi, its[k], cr, ci, maxIter, period, &cycle);
+        total += i - its[k];
+        its[k] = cycle ? maxIter : i;
+        if (cycle && saved) {
+            *saved += maxIter - i;
+        }
+        zrIo[k] = cycle ? NAN : (double) zr;
+        ziIo[k] = cycle ? NAN : (double) zi;
+    }
+    return total;
+}
+
+/* POINTS D'ENTREE ************************************************************/
+
+// Choix de l'instanciation (fractale, détection de cycles). Ces fonctions
+// sont intégrées dans les points d'entrée, donc compilées pour le jeu
+// d'instructions de chacun.
+
+#define SPAN_PARAMS T re0, T im0, T dre, T dim, int n, T cr, T ci, int maxIter, int *out, bool period, \
+                    long *saved, double *zr, double *zi
+#define SPAN_ARGS re0, im0, dre, dim, n, cr, ci, maxIter, out
+#define RESUME_PARAMS double *zr, double *zi, int *its, int n, T cr, T ci, int maxIter, bool period, long *saved
+#define RESUME_ARGS zr, zi, its, n, cr, ci, maxIter
+
+// Noyau d'une formule : vectoriel, ou scalaire quand N vaut 1
+template<int F, typename T, typename V, typename M, int N>
+struct kernel_t {
+    static inline __attribute__((always_inline))
+    long span(SPAN_PARAMS) {
+        if (period) {
+            return escapeSpanT<F, T, V, M, N, true>(SPAN_ARGS, saved, zr, zi);
+        }
+        return escapeSpanT<F, T, V, M, N, false>(SPAN_ARGS, saved, zr, zi);
+    }
+
+    static inline __attribute__((always_inline))
+    long resume(RESUME_PARAMS) {
+        if (period) {
+            return escapeResumeT<F, T, V, M, N, true>(RESUME_ARGS, saved);
+        }
+        return escapeResumeT<F, T, V, M, N, false>(RESUME_ARGS, saved);
+    }
+};
+
+template<int F, typename T, typename V, typename M>
+struct kernel_t<F, T, V, M, 1> {
+    static inline __attribute__((always_inline))
+    long span(SPAN_PARAMS) {
+        return escapeSpanScalarT<F, T>(SPAN_ARGS, period, saved, zr, zi);
+    }
+
+    static inline __attribute__((always_inline))
+    long resume(RESUME_PARAMS) {
+        return escapeResumeScalarT<F, T>(RESUME_ARGS, period, saved);
+    }
+};
+
+template<typename T, typename V, typename M, int N>
+static inline __attribute__((always_inline))
+long spanDispatch(int fractal, SPAN_PARAMS) {
+    switch (fractal) {
+      case FRACTAL_JULIA3:
+        return kernel_t<FRACTAL_JULIA3, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      case FRACTAL_JULIA4:
+        return kernel_t<FRACTAL_JULIA4, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      case FRACTAL_JULIA5:
+        return kernel_t<FRACTAL_JULIA5, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      case FRACTAL_MANDELBROT:
+        return kernel_t<FRACTAL_MANDELBROT, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      case FRACTAL_BURNING_SHIP:
+        return kernel_t<FRACTAL_BURNING_SHIP, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      case FRACTAL_TRICORN:
+        return kernel_t<FRACTAL_TRICORN, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+      default:
+        return kernel_t<FRACTAL_JULIA, T, V, M, N>::span(SPAN_ARGS, period, saved, zr, zi);
+    }
+}
+
+// Seuls les ensembles de Julia se reprennent (voir escapeResumeT)
+template<typename T, typename V, typename M, int N>
+static inline __attribute__((always_inline))
+long resumeDispatch(int fractal, RESUME_PARAMS) {
+    switch (fractal) {
+      case FRACTAL_JULIA3:
+        return kernel_t<FRACTAL_JULIA3, T, V, M, N>::resume(RESUME_ARGS, period, saved);
+      case FRACTAL_JULIA4:
+        return kernel_t<FRACTAL_JULIA4, T, V, M, N>::resume(RESUME_ARGS, period, saved);
+      case FRACTAL_JULIA5:
+        return kernel_t<FRACTAL_JULIA5, T, V, M, N>::resume(RESUME_ARGS, period, saved);
+      default:
+        return kernel_t<FRACTAL_JULIA, T, V, M, N>::resume(RESUME_ARGS, period, saved);
+    }
+}
+
+#undef SPAN_PARAMS
+#undef RESUME_PARAMS
+#define SPAN_CALL SPAN_ARGS, period, saved, zr, zi
+#define RESUME_CALL RESUME_ARGS, period, saved
+
+inline __attribute__((target("avx512f")))
+long escapeSpanDoubleAvx512(int fractal, double re0, double im0, double dre, double dim, int n,
+                            double cr, double ci, int maxIter, int *out, bool period, long *saved,
+                            double *zr, double *zi) {
+    return spanDispatch<double, v8d, v8l, 8>(fractal, SPAN_CALL);
+}
+
+inline __attribute__((target("avx2")))
+long escapeSpanDoubleAvx2(int fractal, double re0, double im0, double dre, double dim, int n,
+                          double cr, double ci, int maxIter, int *out, bool period, long *saved,
+                          double *zr, double *zi) {
+    return spanDispatch<double, v4d, v4l, 4>(fractal, SPAN_CALL);
+}
+
+inline __attribute__((target("avx512f")))
+long escapeSpanFloatAvx512(int fractal, float re0, float im0, float dre, float dim, int n,
+                           float cr, float ci, int maxIter, int *out, bool period, long *saved,
+                           double *zr, double *zi) {
+    return spanDispatch<float, v16f, v16i, 16>(fractal, SPAN_CALL);
+}
+
+inline __attribute__((target("avx2")))
+long escapeSpanFloatAvx2(int fractal, float re0, float im0, float dre, float dim, int n,
+                         float cr, float ci, int maxIter, int *out, bool period, long *saved,
+                         double *zr, double *zi) {
+    return spanDispatch<float, v8f, v8i, 8>(fractal, SPAN_CALL);
+}
+
+inline long escapeSpanDouble(double re0, double im0, double dre, double dim, int n,
+                             double cr, double ci, int maxIter, int *out, bool period, long *saved,
+                             int fractal = FRACTAL_JULIA, double *zr = NULL, double *zi = NULL) {
+    switch (simdLevel) {
+      case SIMD_AVX512:
+        return escapeSpanDoubleAvx512(fractal, SPAN_CALL);
+      case SIMD_AVX2:
+        return escapeSpanDoubleAvx2(fractal, SPAN_CALL);
+      default:
+        return spanDispatch<double, double, long, 1>(fractal, SPAN_CALL);
+    }
+}
+
+inline long escapeSpanFloat(float re0, float im0, float dre, float dim, int n,
+                            float cr, float ci, int maxIter, int *out, bool period, long *saved,
+                            int fractal = FRACTAL_JULIA, double *zr = NULL, double *zi = NULL) {
+    switch (simdLevel) {
+      case SIMD_AVX512:
+        return escapeSpanFloatAvx512(fractal, SPAN_CALL);
+      case SIMD_AVX2:
+        return escapeSpanFloatAvx2(fractal, SPAN_CALL);
+      default:
+        return spanDispatch<float, float, int, 1>(fractal, SPAN_CALL);
+    }
+}
+
+inline long escapeSpanLongDouble(long double re0, long double im0, long double dre, long double dim, int n,
+                                 long double cr, long double ci, int maxIter, int *out, bool period, long *saved,
+                                 int fractal = FRACTAL_JULIA) {
+    double *zr = NULL;
+    double *zi = NULL;
+    return spanDispatch<long double, long double, long, 1>(fractal, SPAN_CALL);
+}
+
+inline __attribute__((target("avx512f")))
+long escapeResumeDoubleAvx512(int fractal, double *zr, double *zi, int *its, int n, double cr, double ci,
+                              int maxIter, bool period, long *saved) {
+    return resumeDispatch<double, v8d, v8l, 8>(fractal, RESUME_CALL);
+}
+
+inline __attribute__((target("avx2")))
+long escapeResumeDoubleAvx2(int fractal, double *zr, double *zi, int *its, int n, double cr, double ci,
+                            int maxIter, bool period, long *saved) {
+    return resumeDispatch<double, v4d, v4l, 4>(fractal, RESUME_CALL);
+}
+
+inline __attribute__((target("avx512f")))
+long escapeResumeFloatAvx512(int fractal, double *zr, double *zi, int *its, int n, float cr, float ci,
+                             int maxIter, bool period, long *saved) {
+    return resumeDispatch<float, v16f, v16i, 16>(fractal, RESUME_CALL);
+}
+
+inline __attribute__((target("avx2")))
+long escapeResumeFloatAvx2(int fractal, double *zr, double *zi, int *its, int n, float cr, float ci,
+                           int maxIter, bool period, long *saved) {
+    return resumeDispatch<float, v8f, v8i, 8>(fractal, RESUME_CALL);
+}
+
+inline long escapeResumeDouble(double *zr, double *zi, int *its, int n, double cr, double ci, int maxIter,
+                               bool period, long *saved, int fractal = FRACTAL_JULIA) {
+    switch (simdLevel) {
+      case SIMD_AVX512:
+        return escapeResumeDoubleAvx512(fractal, RESUME_CALL);
+      case SIMD_AVX2:
+        return escapeResumeDoubleAvx2(fractal, RESUME_CALL);
+      default:
+        return resumeDispatch<double, double, long, 1>(fractal, RESUME_CALL);
+    }
+}
+
+inline long escapeResumeFloat(double *zr, double *zi, int *its, int n, float cr, float ci, int maxIter,
+                              bool period, long *saved, int fractal = FRACTAL_JULIA) {
+    switch (simdLevel) {
+      case SIMD_AVX512:
+        return escapeResumeFloatAvx512(fractal, RESUME_CALL);
+      case SIMD_AVX2:
+        return escapeResumeFloatAvx2(fractal, RESUME_CALL);
+      default:
+        return resumeDispatch<float, float, int, 1>(fractal, RESUME_CALL);
+    }
+}
+
+#undef SPAN_ARGS
+#undef RESUME_ARGS
+#undef SPAN_CALL
+#undef RESUME_CALL
+
+/* DOUBLE-DOUBLE **************************************************************/
+
+// Nombre représenté par hi + lo (environ 106 bits de mantisse).
+typedef struct {
+    double hi;
+    double lo;
+} dd_t;
+
+static inline dd_t dd_quick_two_sum(double a, double b) {
+    dd_t r;
+    r.hi = a + b;
+    r.lo = b - (r.hi - a);
+    return r;
+}
+
+static inline dd_t dd_two_sum(double a, double b) {
+    dd_t r;
+    r.hi = a + b;
+    double bb = r.hi - a;
+    r.lo = (a - (r.hi - bb)) + (b - bb);
+    return r;
+}
+
+// Produit exact de deux doubles (découpage de Dekker, sans FMA)
+static inline dd_t dd_two_prod(double a, double b) {
+    const double split = 134217729.0; // 2^27 + 1
+    double t = split * a;
+    double ahi = t - (t - a);
+    double alo = a - ahi;
+    t = split * b;
+    double bhi = t - (t - b);
+    double blo = b - bhi;
+    dd_t r;
+    r.hi = a * b;
+    r.lo = ((ahi * bhi - r.hi) + ahi * blo + alo * bhi) + alo * blo;
+    return r;
+}
+
+inline dd_t new_dd(long double x) {
+    dd_t r;
+    r.hi = (double) x;
+    r.lo = (double) (x - r.hi);
+    return r;
+}
+
+inline dd_t add_dd(dd_t a, dd_t b) {
+    dd_t s = dd_two_sum(a.hi, b.hi);
+    dd_t t = dd_two_sum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = dd_quick_two_sum(s.hi, s.lo);
+    s.lo += t.lo;
+    return dd_quick_two_sum(s.hi, s.lo);
+}
+
+inline dd_t neg_dd(dd_t a) {
+    a.hi = -a.hi;
+    a.lo = -a.lo;
+    return a;
+}
+
+inline dd_t mult_dd(dd_t a, dd_t b) {
+    dd_t p = dd_two_prod(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return dd_quick_two_sum(p.hi, p.lo);
+}
+
+/* PERTURBATION ***************************************************************/
+
+// Orbite de référence calculée en double-double puis stockée en double :
+// re[n] + i im[n] = Z_n, pour n de 0 à len - 1.
+typedef struct {
+    int len;
+    double *re;
+    double *im;
+} ref_orbit_t;
+
+inline ref_orbit_t* new_ref_orbit(dd_t zr, dd_t zi, dd_t cr, dd_t ci, int maxIter) {
+    ref_orbit_t *o = (ref_orbit_t*) malloc(sizeof(ref_orbit_t));
+    o->re = (double*) malloc((maxIter + 1) * sizeof(double));
+    o->im = (double*) malloc((maxIter + 1) * sizeof(double));
+    o->len = 0;
+    dd_t two = new_dd(2.0);
+    for (int i = 0; i <= maxIter; i++) {
+        o->re[i] = zr.hi;
+        o->im[i] = zi.hi;
+        o->len++;
+        if (zr.hi * zr.hi + zi.hi * zi.hi > MAX_NORM) {
+            break;
+        }
+        dd_t r = add_dd(add_dd(mult_dd(zr, zr), neg_dd(mult_dd(zi, zi))), cr);
+        zi = add_dd(mult_dd(mult_dd(two, zr), zi), ci);
+        zr = r;
+    }
+    return o;
+}
+
+inline void free_ref_orbit(ref_orbit_t *o) {
+    if (o) {
+        free(o->re);
+        free(o->im);
+        free(o);
+    }
+}
+
+// Itère un pixel en perturbation à partir de l'orbite o (indice 0) et de
+// l'écart (dr, di), sachant que it itérations ont déjà été faites.
+// Seuls les écarts sont itérés en double : z_n = Z_n + delta_n avec
+// delta_n+1 = (2 Z_n + delta_n) delta_n. Quand |z| devient plus petit que
+// |delta| (ou que l'orbite s'arrête), on repart de l'orbite critique
+// (W_0 = 0) avec delta = z. La détection de cycles porte sur z.
+inline int perturbDot(const ref_orbit_t *o, const ref_orbit_t *crit, double dr, double di, int it, int maxIter,
+                      bool period, long *saved) {
+    const double eps = periodEps<double>();
+    double sr = o->re[0] + dr;
+    double si = o->im[0] + di;
+    int check = 1;
+    int m = 0;
+    for (int k = 0; it < maxIter; it++, k++) {
+        double tr = o->re[m] + o->re[m] + dr;
+        double ti = o->im[m] + o->im[m] + di;
+        double ndr = tr * dr - ti * di;
+        double ndi = tr * di + ti * dr;
+        m++;
+        double zr = o->re[m] + ndr;
+        double zi = o->im[m] + ndi;
+        double norm = zr * zr + zi * zi;
+        if (norm > MAX_NORM) {
+            break;
+        }
+        if (period) {
+            if (absT(zr - sr) + absT(zi - si) <= eps) {
+                if (saved) {
+                    *saved += maxIter - it - 1;
+                }
+                return maxIter;
+            }
+            if (k + 1 == check) {
+                sr = zr;
+                si = zi;
+                check <<= 1;
+            }
+        }
+        if (m + 1 >= o->len || norm < ndr * ndr + ndi * ndi) {
+            o = crit;
+            m = 0;
+            dr = zr;
+            di = zi;
+        } else {
+            dr = ndr;
+            di = ndi;
+        }
+    }
+    return it;
+}
+
+// Calcule n pixels dont l'écart au centre de l'orbite ref vaut
+// (d0r + k * ddr, d0i + k * ddi). Tous les pixels d'un vecteur suivent
+// le même indice de l'orbite de référence ; ceux qui doivent changer
+// d'orbite sont terminés par perturbDot.
+template<typename V, typename M, int N, bool PERIOD>
+static inline __attribute__((always_inline))
+long escapeSpanPerturbT(const ref_orbit_t *ref, const ref_orbit_t *crit,
+                        double d0r, double d0i, double ddr, double ddi, int n,
+                        int maxIter, int *out, long *saved) {
+    long total = 0;
+    const double eps = periodEps<double>();
+    V lane;
+    for (int k = 0; k < N; k++) {
+        lane[k] = k;
+    }
+
+    for (int i = 0; i < n; i += N) {
+        V idx = lane + (double) i;
+        V dr = d0r + idx * ddr;
+        V di = d0i + idx * ddi;
+        V zr = ref->re[0] + dr;
+        V zi = ref->im[0] + di;
+        V sr = zr;
+        V si = zi;
+        M cnt = {};
+        M active = cnt == 0;
+        M deferred = cnt;
+        M cycle = cnt;
+        int check = 1;
+
+        int m = 0;
+        while (m < maxIter && m + 1 < ref->len) {
+            V tr = ref->re[m] + ref->re[m] + dr;
+            V ti = ref->im[m] + ref->im[m] + di;
+            V ndr = tr * dr - ti * di;
+            V ndi = tr * di + ti * dr;
+            m++;
+            V nzr = ref->re[m] + ndr;
+            V nzi = ref->im[m] + ndi;
+            V norm = nzr * nzr + nzi * nzi;
+            M alive = active & (norm <= (double) MAX_NORM);
+            cnt -= alive;
+            zr = active ? nzr : zr;
+            zi = active ? nzi : zi;
+            if (PERIOD) {
+                V er = zr - sr;
+                V ei = zi - si;
+                er = er < 0.0 ? -er : er;
+                ei = ei < 0.0 ? -ei : ei;
+                M same = alive & (er + ei <= eps);
+                cycle |= same;
+                alive &= ~same;
+                if (m == check) {
+                    sr = zr;
+                    si = zi;
+                    check <<= 1;
+                }
+            }
+            M glitch = alive & (norm < ndr * ndr + ndi * ndi);
+            deferred |= glitch;
+            dr = ndr;
+            di = ndi;
+            active = alive & ~glitch;
+            if ((m & 7) == 0 && !anyLane<M, N>(active)) {
+                break;
+            }
+        }
+        deferred |= active; // l'orbite de référence est épuisée
+
+        for (int k = 0; k < N && i + k < n; k++) {
+            int it = cnt[k];
+            total += it;
+            if (cycle[k]) {
+                if (saved) {
+                    *saved += maxIter - it;
+                }
+                it = maxIter;
+            }
+            else if (deferred[k] && it < maxIter) {
+                long s = 0;
+                int done = it;
+                it = perturbDot(crit, crit, zr[k], zi[k], it, maxIter, PERIOD, &s);
+                total += it - done - s;
+                if (saved) {
+                    *saved += s;
+                }
+            }
+            out[i + k] = it;
+        }
+    }
+    return total;
+}
+
+inline __attribute__((target("avx512f")))
+long escapeSpanPerturbAvx512(const ref_orbit_t *ref, const ref_orbit_t *crit,
+                             double d0r, double d0i, double ddr, double ddi, int n,
+                             int maxIter, int *out, bool period, long *saved) {
+    if (period) {
+        return escapeSpanPerturbT<v8d, v8l, 8, true>(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, saved);
+    }
+    return escapeSpanPerturbT<v8d, v8l, 8, false>(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, saved);
+}
+
+inline __attribute__((target("avx2")))
+long escapeSpanPerturbAvx2(const ref_orbit_t *ref, const ref_orbit_t *crit,
+                           double d0r, double d0i, double ddr, double ddi, int n,
+                           int maxIter, int *out, bool period, long *saved) {
+    if (period) {
+        return escapeSpanPerturbT<v4d, v4l, 4, true>(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, saved);
+    }
+    return escapeSpanPerturbT<v4d, v4l, 4, false>(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, saved);
+}
+
+inline long escapeSpanPerturb(const ref_orbit_t *ref, const ref_orbit_t *crit,
+                              double d0r, double d0i, double ddr, double ddi, int n,
+                              int maxIter, int *out, bool period, long *saved) {
+    switch (simdLevel) {
+      case SIMD_AVX512:
+        return escapeSpanPerturbAvx512(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, period, saved);
+      case SIMD_AVX2:
+        return escapeSpanPerturbAvx2(ref, crit, d0r, d0i, ddr, ddi, n, maxIter, out, period, saved);
+      default:
+        break;
+    }
+    long total = 0;
+    for (int k = 0; k < n; k++) {
+        long s = 0;
+        out[k] = perturbDot(ref, crit, d0r + k * ddr, d0i + k * ddi, 0, maxIter, period, &s);
+        total += out[k] - s;
+        if (saved) {
+            *saved += s;
+        }
+    }
+    return total;
+}
+
+#endif // KERNELS_H_INCLUDED